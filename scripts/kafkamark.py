@@ -23,11 +23,13 @@ options:
     -h, --help
 
 available commands:
+    agents      Run benchmark with many coordinated producer/consumer agents.
     format      Print a raw log in a human-readable format.
     report      Generate a benchmark report from the benchmark logs.
     plot        Plot a datafile.
     run         Run benchmark.
     sweep       Commands benchmarking over a range of configurations.
+    trace       Convert a CSV traffic capture into a replayable trace.
 
 See 'kafkamark <command> --help' for more information on a specific command.
 
@@ -42,7 +44,11 @@ if __name__ == '__main__':
 
     argv = [args['<command>']] + args['<args>']
 
-    if args['<command>'] == 'format':
+    if args['<command>'] == 'agents':
+        import kafkamark_agents
+        args = docopt(kafkamark_agents.__doc__, argv=argv)
+        kafkamark_agents.agents_run(args)
+    elif args['<command>'] == 'format':
         import kafkamark_format
         args = docopt(kafkamark_format.__doc__, argv=argv)
         kafkamark_format.format(args)
@@ -59,6 +65,10 @@ if __name__ == '__main__':
     elif args['<command>'] == 'sweep':
         import kafkamark_sweep
         kafkamark_sweep.sweep(argv)
+    elif args['<command>'] == 'trace':
+        import kafkamark_trace
+        args = docopt(kafkamark_trace.__doc__, argv=argv)
+        kafkamark_trace.trace(args)
     else:
         exit("%r is not a kafkamark.py command. "
              "See 'kafkamark --help'." % args['<command>'])
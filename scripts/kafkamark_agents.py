@@ -0,0 +1,278 @@
+# ISC License
+#
+# Copyright (c) 2017, Stanford University
+#
+# Permission to use, copy, modify, and/or distribute this software for any
+# purpose with or without fee is hereby granted, provided that the above
+# copyright notice and this permission notice appear in all copies.
+#
+# THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+# REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+# AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+# INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+# LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+# OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+# PERFORMANCE OF THIS SOFTWARE.
+
+'''
+usage: kafkamark agents [options] <bindir> [-- <args>...]
+
+Run a benchmark with many producer and consumer agents.  Local agents are
+started on consecutive ports beginning at --base-port; agents already
+running elsewhere (started with --agent.port) are added with --connect.
+All agents start and stop their workloads at the same time, and their
+counters and histograms are merged into a single result.  Arguments after
+'--' are passed to every local agent and must therefore be accepted by both
+the producer and the consumer (e.g. --brokers, --topic); role specific
+options go in --producer-args and --consumer-args.
+
+options:
+    -h, --help
+    -p, --producers <arg>       Number of local producer agents. [default: 1]
+    -c, --consumers <arg>       Number of local consumer agents. [default: 1]
+    --base-port <arg>           First control port of the local agents.
+                                [default: 7100]
+    --connect <arg>             Comma separated host:port list of remote
+                                agents to include.
+    -r, --run-time <arg>        Duration of the experiment in seconds.
+                                [default: 10]
+    --start-delay <arg>         Seconds between sending START and the start
+                                of the workload. [default: 2]
+    -L, --logDir <arg>          Destination log directory; each local agent
+                                logs to its own sub-directory and the merged
+                                result is written to agents.data.
+    --producer-args <arg>       Arguments passed only to the local producer
+                                agents (e.g. "--throughput.ops 1000").
+    --consumer-args <arg>       Arguments passed only to the local consumer
+                                agents (e.g. "--event.driven").
+'''
+
+import os
+import shlex
+import signal
+import socket
+import subprocess
+import time
+
+from kafkamark_filenames import AGENTS_DATA_FILE
+
+# Must match Histogram::SUB_BUCKETS in src/Histogram.h
+SUB_BUCKETS = 16
+
+agents = []
+processes = []
+
+def agents_run(args):
+    try:
+        run_agents(args)
+    finally:
+        cleanup()
+
+def run_agents(args):
+    global agents
+    global processes
+
+    bindir = args['<bindir>'].rstrip('/')
+    basePort = int(args['--base-port'])
+    logDir = args['--logDir']
+    roleArgs = {'producer': shlex.split(args['--producer-args'] or ''),
+                'consumer': shlex.split(args['--consumer-args'] or '')}
+
+    # Start local agents
+    addresses = []
+    roles = ['producer'] * int(args['--producers']) + \
+            ['consumer'] * int(args['--consumers'])
+    for i, role in enumerate(roles):
+        port = basePort + i
+        cmd = ['{0}/{1}'.format(bindir, role), '--agent.port', str(port)]
+        if logDir is not None:
+            agentLogDir = '{0}/{1}-{2}'.format(logDir.rstrip('/'), role, port)
+            if not os.path.exists(agentLogDir):
+                os.makedirs(agentLogDir)
+            cmd += ['--logDir', agentLogDir]
+        cmd += args['<args>'] + roleArgs[role]
+        print_log(' '.join(cmd))
+        process = subprocess.Popen(cmd)
+        processes.append(process)
+        addresses.append((('localhost', port), process))
+
+    if args['--connect'] is not None:
+        for address in args['--connect'].split(','):
+            host, port = address.rsplit(':', 1)
+            addresses.append(((host, int(port)), None))
+
+    try:
+        for address, process in addresses:
+            agents.append(connect(address, process))
+        print_log("connected to {0} agents".format(len(agents)))
+
+        # Start barrier
+        startNS = int((time.time() + float(args['--start-delay'])) * 1e9)
+        durationNS = int(float(args['--run-time']) * 1e9)
+        for agent in agents:
+            agent.sendall('START {0} {1}\n'.format(startNS,
+                                                   durationNS).encode())
+        print_log("run starts in {0} s".format(args['--start-delay']))
+
+        results = [collect(agent) for agent in agents]
+    except KeyboardInterrupt:
+        # Stop barrier; the agents still report what they have.
+        for agent in agents:
+            agent.sendall(b'STOP\n')
+        results = [collect(agent) for agent in agents]
+    print_log("run complete")
+
+    output = format_results(merge(results), len(agents))
+    print(output)
+    if logDir is not None:
+        filePath = "{0}/{1}".format(logDir.rstrip('/'), AGENTS_DATA_FILE)
+        with open(filePath, 'w') as dataFile:
+            dataFile.write(output)
+
+def connect(address, process, timeout=30):
+    deadline = time.time() + timeout
+    while True:
+        # A local agent that exited (e.g. on a bad option) will never listen.
+        if process is not None and process.poll() is not None:
+            exit("agent on {0}:{1} exited with code {2}".format(
+                    address[0], address[1], process.returncode))
+        try:
+            return socket.create_connection(address)
+        except socket.error:
+            if time.time() > deadline:
+                raise
+            time.sleep(0.1)
+
+def collect(agent):
+    counters = {}
+    histograms = {}
+    data = b''
+    while True:
+        chunk = agent.recv(65536)
+        if not chunk:
+            break
+        data += chunk
+        if data.endswith(b'END\n'):
+            break
+    for line in data.decode().splitlines():
+        row = line.split()
+        if len(row) == 0:
+            continue
+        if row[0] == 'COUNTER':
+            counters[row[1]] = int(row[2])
+        elif row[0] == 'HISTOGRAM':
+            histograms[row[1]] = parse_histogram(row[2:])
+    return (counters, histograms)
+
+def parse_histogram(fields):
+    histogram = {'count': int(fields[0]),
+                 'min': int(fields[1]),
+                 'max': int(fields[2]),
+                 'sum': int(fields[3]),
+                 'buckets': {}}
+    for field in fields[4:]:
+        index, count = field.split(':')
+        histogram['buckets'][int(index)] = int(count)
+    return histogram
+
+def merge(results):
+    counters = {}
+    rates = {}
+    histograms = {}
+    for agentCounters, agentHistograms in results:
+        for name, value in agentCounters.items():
+            counters[name] = counters.get(name, 0) + value
+        # Each agent's own rate, so that the total is the offered load.
+        for prefix in ('produced', 'consumed'):
+            duration = agentCounters.get(prefix + '.us', 0)
+            if duration > 0:
+                for unit in ('msgs', 'bytes'):
+                    name = prefix + '.' + unit
+                    if name in agentCounters:
+                        rates[name] = rates.get(name, 0.0) + \
+                                1e6 * agentCounters[name] / duration
+        for name, histogram in agentHistograms.items():
+            if name not in histograms:
+                histograms[name] = {'count': 0, 'min': None, 'max': 0,
+                                    'sum': 0, 'buckets': {}}
+            merged = histograms[name]
+            if histogram['count'] == 0:
+                continue
+            merged['count'] += histogram['count']
+            merged['sum'] += histogram['sum']
+            merged['max'] = max(merged['max'], histogram['max'])
+            if merged['min'] is None or histogram['min'] < merged['min']:
+                merged['min'] = histogram['min']
+            for index, count in histogram['buckets'].items():
+                merged['buckets'][index] = \
+                        merged['buckets'].get(index, 0) + count
+    return (counters, rates, histograms)
+
+def bucket_lower_bound(index):
+    if index < 2 * SUB_BUCKETS:
+        return index
+    shift = index // SUB_BUCKETS - 1
+    return (SUB_BUCKETS + index % SUB_BUCKETS) << shift
+
+def percentile(histogram, fraction):
+    rank = int(fraction * histogram['count'])
+    seen = 0
+    for index in sorted(histogram['buckets']):
+        seen += histogram['buckets'][index]
+        if seen > rank:
+            return bucket_lower_bound(index)
+    return histogram['max']
+
+def format_results(merged, agentCount):
+    counters, rates, histograms = merged
+    lines = []
+    lines.append("{0:24} {1:>15}".format("agents", agentCount))
+    for name in sorted(counters):
+        lines.append("{0:24} {1:>15}".format(name, counters[name]))
+    for name in sorted(rates):
+        lines.append("{0:24} {1:>15.1f} {2}".format(name + ".rate",
+                                                   rates[name], "/s"))
+    for name in sorted(histograms):
+        histogram = histograms[name]
+        if histogram['count'] == 0:
+            continue
+        lines.append("{0:24} {1:>15}".format(name + ".count",
+                                             histogram['count']))
+        lines.append("{0:24} {1:>15}".format(name + ".min", histogram['min']))
+        for label, fraction in (('.p50', 0.5), ('.p90', 0.9),
+                                ('.p99', 0.99), ('.p999', 0.999)):
+            lines.append("{0:24} {1:>15}".format(
+                    name + label, percentile(histogram, fraction)))
+        lines.append("{0:24} {1:>15}".format(name + ".max", histogram['max']))
+        # Keep the merged histogram so that results can be merged again.
+        lines.append("# HISTOGRAM {0} {1} {2} {3} {4} {5}".format(
+                name, histogram['count'], histogram['min'], histogram['max'],
+                histogram['sum'],
+                ' '.join('{0}:{1}'.format(index, histogram['buckets'][index])
+                         for index in sorted(histogram['buckets']))))
+    return '\n'.join(lines) + '\n'
+
+def print_log(msg):
+    print("[ {0} ] {1}".format(
+            time.strftime("%d %b %Y %H:%M:%S", time.localtime()),
+            msg))
+
+def cleanup():
+    global agents
+    global processes
+
+    for agent in agents:
+        agent.close()
+    agents = []
+
+    for process in processes:
+        if process.poll() is None:
+            process.send_signal(signal.SIGINT)
+    deadline = time.time() + 10
+    for process in processes:
+        while process.poll() is None and time.time() < deadline:
+            time.sleep(0.1)
+        if process.poll() is None:
+            process.kill()
+            print_log("agent ({0}) killed".format(process.pid))
+    processes = []
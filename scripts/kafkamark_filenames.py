@@ -17,4 +17,10 @@
 LATENCY_DATA_FILE = "latency.data"
 BATCH_INTERVAL_FILE = "batch_interval.data"
 BATCH_SIZE_FILE = "batch_size.data"
+CATCHUP_DATA_FILE = "catchup.data"
+COMMIT_DATA_FILE = "commit_latency.data"
+RTT_DATA_FILE = "rtt.data"
+REPLAY_DRIFT_FILE = "replay_drift.data"
+PACING_ERROR_FILE = "pacing_error.data"
+AGENTS_DATA_FILE = "agents.data"
 PARAM_FILE = "param.p"
@@ -25,6 +25,16 @@ options:
     -q, --quiet         Don't output to standard out.
     -b, --batching      Print the 'batching' section of the report.
     -l, --latency       Print the 'latency' section of the report.
+    -c, --catchup       Print the 'catchup' section of the report.
+    -x, --commit        Print the 'commit' section of the report.
+    -r, --rtt           Print the 'rtt' section of the report.
+    -T, --topics        Print the 'topics' section of the report.
+    -e, --events        Print the 'events' section of the report.
+    -p, --replay        Print the 'replay' section of the report.
+    -P, --pacing        Print the 'pacing' section of the report.
+    -a, --alloc         Print the 'alloc' section of the report.
+    --baseline <dir>    Log directory of a run without transactions; the
+                        'commit' section compares throughput against it.
     --clean             Cleanup and remove gnerated ouput files.
 '''
 
@@ -36,6 +46,11 @@ from docopt import docopt
 from kafkamark_filenames import LATENCY_DATA_FILE
 from kafkamark_filenames import BATCH_INTERVAL_FILE
 from kafkamark_filenames import BATCH_SIZE_FILE
+from kafkamark_filenames import CATCHUP_DATA_FILE
+from kafkamark_filenames import COMMIT_DATA_FILE
+from kafkamark_filenames import RTT_DATA_FILE
+from kafkamark_filenames import REPLAY_DRIFT_FILE
+from kafkamark_filenames import PACING_ERROR_FILE
 
 def report(argv):
     args = docopt(__doc__, argv=argv)
@@ -45,6 +60,54 @@ def report(argv):
         report_main(args)
 
 def report_main(args):
+    if args['--catchup']:
+        catchup(args['<dirname>'],
+                args['--force'],
+                args['--summary'],
+                args['--quiet'])
+        return
+
+    if args['--commit']:
+        commit(args['<dirname>'],
+               args['--baseline'],
+               args['--force'],
+               args['--summary'],
+               args['--quiet'])
+        return
+
+    if args['--rtt']:
+        rtt(args['<dirname>'],
+            args['--force'],
+            args['--summary'],
+            args['--quiet'])
+        return
+
+    if args['--alloc']:
+        alloc(args['<dirname>'], args['--quiet'])
+        return
+
+    if args['--pacing']:
+        pacing(args['<dirname>'],
+               args['--force'],
+               args['--summary'],
+               args['--quiet'])
+        return
+
+    if args['--replay']:
+        replay(args['<dirname>'],
+               args['--force'],
+               args['--summary'],
+               args['--quiet'])
+        return
+
+    if args['--events']:
+        events(args['<dirname>'], args['--quiet'])
+        return
+
+    if args['--topics']:
+        topics(args['<dirname>'], args['--quiet'])
+        return
+
     if not args['--batching'] and not args['--latency']:
         full_report = True
     else:
@@ -66,7 +129,12 @@ def report_clean(args):
     dirname = args['<dirname>'].strip('/') + '/'
     files = ( LATENCY_DATA_FILE
             , BATCH_INTERVAL_FILE
-            , BATCH_SIZE_FILE)
+            , BATCH_SIZE_FILE
+            , CATCHUP_DATA_FILE
+            , COMMIT_DATA_FILE
+            , RTT_DATA_FILE
+            , REPLAY_DRIFT_FILE
+            , PACING_ERROR_FILE)
     for filename in files:
         filepath = dirname + filename
         if os.path.exists(filepath):
@@ -179,3 +247,304 @@ def batching(dirname, force, summary, quiet):
         else:
             cat(durationData)
             cat(sizeData)
+
+def catchup(dirname, force, summary, quiet):
+    consumerLog = dirname + "/consumer.log"
+
+    catchupData = dirname + "/" + CATCHUP_DATA_FILE
+
+    if force or not os.path.isfile(catchupData):
+        cps = None
+        samples = []
+        caughtUp = None
+        with open(consumerLog, 'r') as logFile:
+            for line in logFile:
+                row = line.strip().split('|')
+                if row[1] == 'CATCHUP':
+                    samples.append((int(row[0]), int(row[2]), int(row[3]),
+                                    int(row[4])))
+                elif row[1] == 'CAUGHTUP':
+                    caughtUp = float(row[4]) / 1e6
+                elif row[1] == 'CPS':
+                    cps = float(row[2])
+
+        with open(catchupData, 'w') as dataFile:
+            dataFile.write("# Time (s)        MB/s      Msgs/s         Lag\n"
+                           "#---------------------------------------------\n")
+            if caughtUp is not None:
+                dataFile.write("# caught up in %.3f s\n" % caughtUp)
+            for i in xrange(1, len(samples)):
+                seconds = float(samples[i][0] - samples[i - 1][0]) / cps
+                dataFile.write("%10.3f  %10.3f  %10.1f  %10d\n" % (
+                        float(samples[i][0] - samples[0][0]) / cps,
+                        (samples[i][2] - samples[i - 1][2]) / seconds / 1e6,
+                        (samples[i][1] - samples[i - 1][1]) / seconds,
+                        samples[i][3]))
+
+    if not quiet:
+        if summary:
+            catchupSummary(catchupData)
+        else:
+            cat(catchupData)
+
+def catchupSummary(filename):
+    caughtUp = None
+    rates = []
+    with open(filename, 'r') as f:
+        for line in f.readlines():
+            if line.startswith('# caught up in'):
+                caughtUp = float(line.split()[4])
+            if line[0] == '#':
+                continue
+            rates.append(float(line.split()[1]))
+    if caughtUp is None:
+        print("{0:20} {1:>15} {2}".format("catchup.time", "n/a", "s"))
+    else:
+        print("{0:20} {1:>15} {2}".format("catchup.time", caughtUp, "s"))
+    if len(rates) > 0:
+        print("{0:20} {1:>15.3f} {2}".format("catchup.rate.mean",
+                                             np.mean(rates), "MB/s"))
+        print("{0:20} {1:>15.3f} {2}".format("catchup.rate.max",
+                                             max(rates), "MB/s"))
+
+def commit(dirname, baseline, force, summary, quiet):
+    producerLog = dirname + "/producer.log"
+
+    commitData = dirname + "/" + COMMIT_DATA_FILE
+
+    numbers = []
+    with open(producerLog, 'r') as logFile:
+        for line in logFile:
+            row = line.strip().split('|')
+            if row[1] == 'COMMIT':
+                numbers.append(float(row[3]) / 1000)
+
+    if force or not os.path.isfile(commitData):
+        header = ("# Time (ms)    Cum. Fraction\n"
+                 "#---------------------------\n")
+        cdf_write(numbers, header, commitData)
+
+    if not quiet:
+        throughput = produceThroughput(producerLog)
+        if throughput is not None:
+            print("{0:20} {1:>15.1f} {2}".format(
+                    "produce.throughput", throughput, "msgs/s"))
+        if baseline is not None:
+            baselineThroughput = produceThroughput(baseline +
+                                                   "/producer.log")
+            if baselineThroughput is not None:
+                print("{0:20} {1:>15.1f} {2}".format(
+                        "baseline.throughput", baselineThroughput, "msgs/s"))
+            if throughput is not None and baselineThroughput:
+                print("{0:20} {1:>15.1f} {2}".format(
+                        "throughput.cost",
+                        100 * (1 - throughput / baselineThroughput), "%"))
+        if summary:
+            printSummary(commitData, 'commit.latency', 'ms')
+        else:
+            cat(commitData)
+
+def produceThroughput(producerLog):
+    cps = None
+    produceCount = 0
+    firstTSC = None
+    lastTSC = None
+    with open(producerLog, 'r') as logFile:
+        for line in logFile:
+            row = line.strip().split('|')
+            if row[1] == 'PRODUCE':
+                tsc = int(row[0])
+                if firstTSC is None:
+                    firstTSC = tsc
+                lastTSC = tsc
+                produceCount += 1
+            elif row[1] == 'CPS':
+                cps = float(row[2])
+
+    if produceCount < 2:
+        return None
+    return (produceCount - 1) * cps / (lastTSC - firstTSC)
+
+def rtt(dirname, force, summary, quiet):
+    producerLog = dirname + "/producer.log"
+
+    rttData = dirname + "/" + RTT_DATA_FILE
+
+    cps = None
+    replyCount = 0
+    timeoutCount = 0
+    firstTSC = None
+    lastTSC = None
+    numbers = []
+    with open(producerLog, 'r') as logFile:
+        for line in logFile:
+            row = line.strip().split('|')
+            if row[1] == 'REPLY':
+                tsc = int(row[0])
+                if firstTSC is None:
+                    firstTSC = tsc
+                lastTSC = tsc
+                replyCount += 1
+                numbers.append(float(row[3]) / 1000)
+            elif row[1] == 'REPLY_TIMEOUT':
+                timeoutCount += 1
+            elif row[1] == 'CPS':
+                cps = float(row[2])
+
+    if force or not os.path.isfile(rttData):
+        header = ("# Time (ms)    Cum. Fraction\n"
+                 "#---------------------------\n")
+        cdf_write(numbers, header, rttData)
+
+    if not quiet:
+        if replyCount > 1:
+            print("{0:20} {1:>15.1f} {2}".format(
+                    "rtt.throughput",
+                    (replyCount - 1) * cps / (lastTSC - firstTSC),
+                    "msgs/s"))
+        print("{0:20} {1:>15} {2}".format("rtt.timeouts", timeoutCount,
+                                          "msgs"))
+        if summary:
+            printSummary(rttData, 'rtt', 'ms')
+        else:
+            cat(rttData)
+
+def topics(dirname, quiet):
+    producerLog = dirname + "/producer.log"
+
+    with open(producerLog, 'r') as logFile:
+        for line in logFile:
+            row = line.strip().split('|')
+            if row[1] == 'TOPICS':
+                count = int(row[2])
+                if not quiet:
+                    print("{0:20} {1:>15} {2}".format(
+                            "topics.count", count, ""))
+                    print("{0:20} {1:>15.3f} {2}".format(
+                            "topics.open", float(row[3]) / 1000, "ms"))
+                    print("{0:20} {1:>15.1f} {2}".format(
+                            "topics.rss", float(row[4]) / count,
+                            "bytes/topic"))
+            elif row[1] == 'METADATA':
+                if not quiet:
+                    print("{0:20} {1:>15.3f} {2}".format(
+                            "topics.metadata", float(row[3]) / 1000, "ms"))
+
+def events(dirname, quiet):
+    consumerLog = dirname + "/consumer.log"
+
+    with open(consumerLog, 'r') as logFile:
+        for line in logFile:
+            row = line.strip().split('|')
+            if row[1] == 'EVENTS' and not quiet:
+                wakeups = int(row[2])
+                messages = int(row[3])
+                print("{0:20} {1:>15} {2}".format(
+                        "events.wakeups", wakeups, ""))
+                print("{0:20} {1:>15} {2}".format(
+                        "events.messages", messages, ""))
+                if len(row) > 4:
+                    print("{0:20} {1:>15} {2}".format(
+                            "events.timer.ticks", int(row[4]), ""))
+                if wakeups > 0:
+                    print("{0:20} {1:>15.3f} {2}".format(
+                            "events.batch", float(messages) / wakeups,
+                            "msgs/wakeup"))
+
+def replay(dirname, force, summary, quiet):
+    producerLog = dirname + "/producer.log"
+
+    driftData = dirname + "/" + REPLAY_DRIFT_FILE
+
+    traceRecords = None
+    numbers = []
+    with open(producerLog, 'r') as logFile:
+        for line in logFile:
+            row = line.strip().split('|')
+            if row[1] == 'REPLAY':
+                numbers.append(float(row[3]) / 1000)
+            elif row[1] == 'REPLAY_TRACE':
+                traceRecords = int(row[2])
+
+    if force or not os.path.isfile(driftData):
+        header = ("# Drift (us)   Cum. Fraction\n"
+                 "#---------------------------\n")
+        cdf_write(numbers, header, driftData)
+
+    if not quiet:
+        if traceRecords is not None:
+            print("{0:20} {1:>15} {2}".format("replay.replayed",
+                    "{0}/{1}".format(len(numbers), traceRecords), "msgs"))
+        if summary:
+            printSummary(driftData, 'replay.drift', 'us')
+        else:
+            cat(driftData)
+
+def pacing(dirname, force, summary, quiet):
+    producerLog = dirname + "/producer.log"
+
+    errorData = dirname + "/" + PACING_ERROR_FILE
+
+    numbers = []
+    cpu = None
+    with open(producerLog, 'r') as logFile:
+        for line in logFile:
+            row = line.strip().split('|')
+            if row[1] == 'PRODUCE' and len(row) > 3:
+                numbers.append(float(row[3]) / 1000)
+            elif row[1] == 'CPU':
+                cpu = [float(x) for x in row[2:5]]
+
+    if force or not os.path.isfile(errorData):
+        header = ("# Error (us)   Cum. Fraction\n"
+                 "#---------------------------\n")
+        cdf_write(numbers, header, errorData)
+
+    if not quiet:
+        if cpu is not None and cpu[2] > 0:
+            print("{0:20} {1:>15.1f} {2}".format(
+                    "cpu.sender", 100 * cpu[0] / cpu[2], "% of a core"))
+            print("{0:20} {1:>15.1f} {2}".format(
+                    "cpu.process", 100 * cpu[1] / cpu[2], "% of a core"))
+        # Send times only have an error to measure against a target rate.
+        if len(numbers) == 0:
+            print("{0:20} {1:>15} {2}".format("pacing.error", "n/a",
+                                              "(no target rate)"))
+        elif summary:
+            printSummary(errorData, 'pacing.error', 'us')
+        else:
+            cat(errorData)
+
+def alloc(dirname, quiet):
+    for role in ('producer', 'consumer'):
+        logPath = dirname + "/" + role + ".log"
+        if not os.path.isfile(logPath):
+            continue
+
+        samples = []
+        with open(logPath, 'r') as logFile:
+            for line in logFile:
+                row = line.strip().split('|')
+                if row[1] == 'ALLOC':
+                    samples.append([int(x) for x in row[2:8]])
+
+        if len(samples) < 2 or quiet:
+            continue
+
+        first = samples[0]
+        last = samples[-1]
+        msgs = last[0] - first[0]
+        print("{0:20} {1:>15} {2}".format(role + ".msgs", msgs, ""))
+        if msgs > 0:
+            print("{0:20} {1:>15.2f} {2}".format(
+                    role + ".allocs", float(last[1] - first[1]) / msgs,
+                    "allocs/msg"))
+            print("{0:20} {1:>15.1f} {2}".format(
+                    role + ".alloc.bytes", float(last[3] - first[3]) / msgs,
+                    "bytes/msg"))
+        print("{0:20} {1:>15} {2}".format(
+                role + ".heap.peak",
+                max(s[3] - s[4] for s in samples) - (first[3] - first[4]),
+                "bytes"))
+        print("{0:20} {1:>15} {2}".format(
+                role + ".rss.peak", max(s[5] for s in samples), "bytes"))
@@ -29,6 +29,9 @@ options:
 
 general client options:
     -L, --logDir <arg>          Destination log directory for log output.
+    --alloc.stats.ms <arg>      Interval at which heap allocation counters and
+                                RSS are recorded (0 disables allocation
+                                accounting). *Type: integer*
     -b, --brokers <arg>         Broker address
                                 *Type: string*
     -t, --topic <arg>           Topic to fetch / produce
@@ -36,8 +39,21 @@ general client options:
     -g, --group.id <arg>        Client group id string. All clients sharing the
                                 same group.id belong to the same group.
                                 *Type: string*
+    --reply.topic <arg>         Topic on which replies are exchanged in
+                                request/reply mode; the producer consumes
+                                replies from it and the consumer echoes each
+                                message to it. *Type: string*
+    --topic.count <arg>         Number of topics to spread load over, named
+                                <topic>-0 ... <topic>-<N-1>. *Type: integer*
+    --topic.metadata.refresh.interval.ms <arg>
+                                Topic metadata refresh interval in
+                                milliseconds. *Type: integer*
 
 consumer client options:
+    --auto.offset.reset <arg>           Action to take when there is no initial
+                                        offset in offset store or the desired
+                                        offset is out of range.
+                                        *Type: enum value*
     --fetch.wait.max.ms <arg>           Maximum time the broker may wait to fill
                                         the response with fetch.min.bytes.
                                         *Type: integer*
@@ -45,17 +61,68 @@ consumer client options:
                                         request for a topic+partition in case
                                         of a fetch error.
                                         *Type: integer*
+    --isolation.level <arg>             Controls how to read messages written
+                                        transactionally. *Type: enum value*
+    --report.interval.ms <arg>          Interval between catch-up progress
+                                        reports. *Type: integer*
+    --event.driven                      Serve all partition queues from one
+                                        thread with queue event fds and epoll.
+    --event.timer.ms <arg>              Interval of the event-driven
+                                        consumer's housekeeping timer.
+                                        *Type: integer*
 
 producer client options:
     --throughput.ops <arg>                  Operations per second the producer
                                             should attempt to offer.
                                             *Type: float*
+    --msg.size <arg>                        Size in bytes of each produced
+                                            message. *Type: integer*
+    --pacer.spin.us <arg>                   Gaps between sends of at most this
+                                            many us are spun rather than
+                                            slept. *Type: integer*
     --queue.buffering.max.messages <arg>    Maximum number of messages allowed
                                             on the producer queue.
                                             *Type: integer*
     --queue.buffering.max.ms <arg>          Maximum time, in milliseconds, for
                                             buffering data on the producer
                                             queue. *Type: integer*
+    --acks <arg>                            Number of acknowledgements the
+                                            leader broker must receive before
+                                            responding. *Type: integer*
+    --enable.idempotence <arg>              Produce messages exactly once and
+                                            in the original produce order.
+                                            *Type: boolean*
+    --transactional.id <arg>                Enables the transactional
+                                            producer. *Type: string*
+    --transaction.size <arg>                Number of messages produced in
+                                            each transaction.
+                                            *Type: integer*
+    --window <arg>                          Number of outstanding requests in
+                                            request/reply mode.
+                                            *Type: integer*
+    --reply.timeout.ms <arg>                Time after which a request
+                                            without a reply leaves the
+                                            window. *Type: integer*
+    --topic.distribution <arg>              How messages are spread over the
+                                            topics: uniform or zipf.
+    --zipf.exponent <arg>                   Exponent of the zipf topic
+                                            distribution. *Type: float*
+    --replay.trace <arg>                    Replay the traffic recorded in
+                                            this binary trace file (see
+                                            'kafkamark trace').
+    --replay.speed <arg>                    Trace replay speed relative to the
+                                            recorded timestamps.
+                                            *Type: float*
+
+catch-up options:
+    --preload.messages <arg>    Bulk load the topic with this many messages
+                                and then measure how fast the consumer drains
+                                the backlog from the earliest offset.
+                                *Type: integer*
+    --preload.bytes <arg>       Bulk load the topic with this many bytes and
+                                then measure how fast the consumer drains the
+                                backlog from the earliest offset.
+                                *Type: integer*
 '''
 
 import atexit
@@ -97,6 +164,13 @@ def run(args):
     consumer_cmd += getConsumerOptions(args)
     producer_cmd += getProducerOptions(args)
 
+    preload = (args['--preload.messages'] is not None or
+               args['--preload.bytes'] is not None)
+    if preload:
+        consumer_cmd += ' --catchup'
+        producer_cmd += getOption(args, '--preload.messages')
+        producer_cmd += getOption(args, '--preload.bytes')
+
     post_run_cmd = args['--post-run']
 
     if args['--pre-run'] is not None:
@@ -109,6 +183,12 @@ def run(args):
         filePath = "{0}/{1}".format(args['--logDir'].strip('/'), PARAM_FILE)
         pickle.dump(args, open(filePath, 'wb'))
 
+    if preload:
+        runCatchup(consumer_cmd, producer_cmd)
+        cleanup()
+        post_run_cmd = None
+        return
+
     print_log("starting consumer...")
     print_log(consumer_cmd)
     if execute:
@@ -141,25 +221,66 @@ def run(args):
     cleanup()
     post_run_cmd = None
 
+def runCatchup(consumer_cmd, producer_cmd):
+    global consumer
+    global producer
+
+    print_log("starting preload producer...")
+    print_log(producer_cmd)
+    if execute:
+        producer = subprocess.Popen(producer_cmd.split())
+        producer.wait()
+
+    print_log("preload complete")
+
+    print_log("starting catch-up consumer...")
+    print_log(consumer_cmd)
+    if execute:
+        consumer = subprocess.Popen(consumer_cmd.split())
+        consumer.wait()
+
+    print_log("catch-up complete")
+
 def getGeneralOptions(args):
     options = ''
     options += getOption(args, '--logDir')
+    options += getOption(args, '--alloc.stats.ms')
     options += getOption(args, '--brokers')
     options += getOption(args, '--topic')
     options += getOption(args, '--group.id')
+    options += getOption(args, '--reply.topic')
+    options += getOption(args, '--topic.count')
+    options += getOption(args, '--topic.metadata.refresh.interval.ms')
     return options
 
 def getConsumerOptions(args):
     options = ''
     options += getOption(args, '--fetch.wait.max.ms')
     options += getOption(args, '--fetch.error.backoff.ms')
+    options += getOption(args, '--auto.offset.reset')
+    options += getOption(args, '--isolation.level')
+    options += getOption(args, '--report.interval.ms')
+    options += getFlag(args, '--event.driven')
+    options += getOption(args, '--event.timer.ms')
     return options
 
 def getProducerOptions(args):
     options = ''
     options += getOption(args, '--throughput.ops')
+    options += getOption(args, '--msg.size')
+    options += getOption(args, '--pacer.spin.us')
     options += getOption(args, '--queue.buffering.max.messages')
     options += getOption(args, '--queue.buffering.max.ms')
+    options += getOption(args, '--acks')
+    options += getOption(args, '--enable.idempotence')
+    options += getOption(args, '--transactional.id')
+    options += getOption(args, '--transaction.size')
+    options += getOption(args, '--window')
+    options += getOption(args, '--reply.timeout.ms')
+    options += getOption(args, '--topic.distribution')
+    options += getOption(args, '--zipf.exponent')
+    options += getOption(args, '--replay.trace')
+    options += getOption(args, '--replay.speed')
     return options
 
 def getOption(args, optionName):
@@ -168,6 +289,12 @@ def getOption(args, optionName):
         option += ' {0} {1}'.format(optionName, args[optionName])
     return option
 
+def getFlag(args, flagName):
+    flag = ''
+    if args[flagName]:
+        flag += ' {0}'.format(flagName)
+    return flag
+
 def print_log(msg):
     print("[ {0} ] {1}".format(
             time.strftime("%d %b %Y %H:%M:%S", time.localtime()),
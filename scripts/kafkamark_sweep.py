@@ -44,6 +44,7 @@ __plot_usage = '''
 usage: kafkamark sweep plot <input_dirs>...
                             --param <arg>
                             ( --latency
+                            | --rtt
                             | --batch-interval
                             | --batch-size )
 
@@ -61,6 +62,7 @@ from kafkamark_filenames import LATENCY_DATA_FILE
 from kafkamark_filenames import BATCH_INTERVAL_FILE
 from kafkamark_filenames import BATCH_SIZE_FILE
 from kafkamark_filenames import PARAM_FILE
+from kafkamark_filenames import RTT_DATA_FILE
 
 def sweep(argv):
     args = docopt(__doc__, argv=argv, options_first=True)
@@ -116,11 +118,16 @@ def sweep_plot(args):
         x.append(int(param_value))
 
         # Generate Reports
-        kafkamark_report.report(['report', dirname, '-s'])
+        if args['--rtt']:
+            kafkamark_report.report(['report', dirname, '-s', '--rtt'])
+        else:
+            kafkamark_report.report(['report', dirname, '-s'])
 
         # Get Data
         if args['--latency']:
             numbers = getNumbers(dirname + LATENCY_DATA_FILE)
+        elif args['--rtt']:
+            numbers = getNumbers(dirname + RTT_DATA_FILE)
         elif args['--batch-interval']:
             pass
         elif args['--batch-size']:
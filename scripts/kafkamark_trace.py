@@ -0,0 +1,66 @@
+# ISC License
+#
+# Copyright (c) 2017, Stanford University
+#
+# Permission to use, copy, modify, and/or distribute this software for any
+# purpose with or without fee is hereby granted, provided that the above
+# copyright notice and this permission notice appear in all copies.
+#
+# THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+# REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+# AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+# INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+# LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+# OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+# PERFORMANCE OF THIS SOFTWARE.
+
+'''
+usage: kafkamark trace [options] <csvfile> <tracefile>
+
+Convert a CSV traffic capture into a binary trace that the producer can
+replay with --replay.trace.  Each CSV line describes one message as:
+
+    <timestamp ns>,<size>,<key>,<topic index>,<partition>
+
+Timestamps are made relative to the first message.  An empty key means the
+message has no key (keys are otherwise integers) and a partition of -1 lets
+the producer's partitioner choose.
+
+options:
+    -h, --help
+'''
+
+import struct
+
+TRACE_MAGIC = b'KMTRACE\0'
+TRACE_VERSION = 1
+TRACE_HEADER = struct.Struct('<8sII')
+TRACE_RECORD = struct.Struct('<QQIIiI')
+TRACE_FLAG_KEY = 1 << 0
+
+def trace(args):
+    with open(args['<csvfile>'], 'r') as csvFile:
+        with open(args['<tracefile>'], 'wb') as traceFile:
+            traceFile.write(TRACE_HEADER.pack(TRACE_MAGIC,
+                                              TRACE_VERSION,
+                                              TRACE_RECORD.size))
+            startTime = None
+            for line in csvFile:
+                line = line.strip()
+                if len(line) == 0 or line[0] == '#':
+                    continue
+                row = line.split(',')
+                timestamp = int(row[0])
+                if startTime is None:
+                    startTime = timestamp
+                flags = 0
+                key = 0
+                if row[2] != '':
+                    flags |= TRACE_FLAG_KEY
+                    key = int(row[2]) & 0xffffffffffffffff
+                traceFile.write(TRACE_RECORD.pack(timestamp - startTime,
+                                                  key,
+                                                  int(row[1]),
+                                                  int(row[3]),
+                                                  int(row[4]),
+                                                  flags))
@@ -0,0 +1,235 @@
+/* Copyright (c) 2017, Stanford University
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+ * OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "Agent.h"
+
+#include <errno.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <iostream>
+#include <sstream>
+
+#include "TraceLog.h"
+
+namespace Kafkamark {
+
+/**
+ * Return the current CLOCK_REALTIME time in ns.
+ */
+static uint64_t
+realtimeNS()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    return now.tv_sec * 1000000000UL + now.tv_nsec;
+}
+
+/**
+ * Start listening for the driver on the provided port.  Exits if the control
+ * socket cannot be set up.
+ *
+ * \param port
+ *      TCP port on which to listen for the driver.
+ * \param stopCallback
+ *      Function called (from another thread) once the workload should stop.
+ */
+Agent::Agent(uint16_t port, void (*stopCallback)())
+    : listenFd(-1)
+    , controlFd(-1)
+    , stopTimeNS(0)
+    , stopCallback(stopCallback)
+    , stopWatcher()
+{
+    listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    int reuse = 1;
+    setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    if (listenFd < 0 ||
+            bind(listenFd, (struct sockaddr*) &addr, sizeof(addr)) < 0 ||
+            listen(listenFd, 1) < 0) {
+        std::cerr << "Failed to listen on agent port " << port << ": "
+                  << strerror(errno) << std::endl;
+        exit(1);
+    }
+}
+
+/**
+ * Agent Destructor
+ */
+Agent::~Agent()
+{
+    if (stopWatcher.joinable()) {
+        stopWatcher.join();
+    }
+    if (controlFd >= 0) {
+        close(controlFd);
+    }
+    close(listenFd);
+}
+
+/**
+ * Wait for the driver to connect and send START, and then until the start
+ * time it requested.  Exits if the driver does not follow the protocol.
+ */
+void
+Agent::waitForStart()
+{
+    controlFd = accept(listenFd, NULL, NULL);
+    if (controlFd < 0) {
+        std::cerr << "Failed to accept the driver connection: "
+                  << strerror(errno) << std::endl;
+        exit(1);
+    }
+
+    std::string line;
+    std::string command;
+    uint64_t startTimeNS = 0;
+    uint64_t durationNS = 0;
+    if (readLine(&line)) {
+        std::istringstream in(line);
+        in >> command >> startTimeNS >> durationNS;
+    }
+    if (command != "START") {
+        std::cerr << "Expected START from the driver: " << line << std::endl;
+        exit(1);
+    }
+
+    struct timespec startTime;
+    startTime.tv_sec = startTimeNS / 1000000000;
+    startTime.tv_nsec = startTimeNS % 1000000000;
+    while (clock_nanosleep(CLOCK_REALTIME, TIMER_ABSTIME, &startTime, NULL)
+            == EINTR);
+
+    TraceLog::record("AGENT|START|%lu|%lu", startTimeNS, realtimeNS());
+    stopTimeNS = startTimeNS + durationNS;
+    stopWatcher = std::thread(&Agent::watchForStop, this);
+}
+
+/**
+ * Report a counter to the driver.  Must be called after the workload stopped.
+ */
+void
+Agent::sendCounter(const char* name, uint64_t value)
+{
+    std::ostringstream out;
+    out << "COUNTER " << name << " " << value;
+    writeLine(out.str());
+}
+
+/**
+ * Report a histogram to the driver.  Must be called after the workload
+ * stopped.
+ */
+void
+Agent::sendHistogram(const char* name, const Histogram& histogram)
+{
+    std::ostringstream out;
+    out << "HISTOGRAM " << name << " " << histogram.serialize();
+    writeLine(out.str());
+}
+
+/**
+ * Tell the driver all results have been reported.
+ */
+void
+Agent::finish()
+{
+    if (stopWatcher.joinable()) {
+        stopWatcher.join();
+    }
+    writeLine("END");
+}
+
+/**
+ * Body of the stopWatcher thread; calls the stop callback at the stop time,
+ * or earlier if the driver sends STOP or disconnects.
+ */
+void
+Agent::watchForStop()
+{
+    while (true) {
+        uint64_t now = realtimeNS();
+        if (now >= stopTimeNS) {
+            break;
+        }
+
+        struct pollfd control;
+        control.fd = controlFd;
+        control.events = POLLIN;
+        int timeoutMS = static_cast<int>((stopTimeNS - now) / 1000000) + 1;
+        if (poll(&control, 1, timeoutMS) > 0) {
+            // Either STOP or the driver went away; stop in both cases.
+            std::string line;
+            readLine(&line);
+            break;
+        }
+    }
+    stopCallback();
+}
+
+/**
+ * Read a newline terminated line from the driver.
+ *
+ * \param line
+ *      Set to the line read, without the newline.
+ * \return
+ *      True, if a complete line was read.  False, if the driver disconnected.
+ */
+bool
+Agent::readLine(std::string* line)
+{
+    line->clear();
+    char c;
+    while (read(controlFd, &c, 1) == 1) {
+        if (c == '\n') {
+            return true;
+        }
+        line->push_back(c);
+    }
+    return false;
+}
+
+/**
+ * Write a line to the driver, appending the newline.
+ */
+void
+Agent::writeLine(const std::string& line)
+{
+    std::string data = line + "\n";
+    size_t written = 0;
+    while (written < data.size()) {
+        ssize_t len = send(controlFd, data.data() + written,
+                           data.size() - written, MSG_NOSIGNAL);
+        if (len <= 0) {
+            std::cerr << "Failed to report to the driver: "
+                      << strerror(errno) << std::endl;
+            return;
+        }
+        written += len;
+    }
+}
+
+}  // namespace Kafkamark
@@ -0,0 +1,79 @@
+/* Copyright (c) 2017, Stanford University
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+ * OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef KAFKAMARK_AGENT_H
+#define KAFKAMARK_AGENT_H
+
+#include <stdint.h>
+
+#include <string>
+#include <thread>
+
+#include "Histogram.h"
+
+namespace Kafkamark {
+
+/**
+ * Lets a producer or consumer be run as one of many load generating agents
+ * coordinated by a single driver ('kafkamark agents').  The agent listens on
+ * a TCP control socket and speaks a line based protocol with the driver:
+ *
+ *   driver -> agent:  START <start time> <duration>
+ *                     STOP
+ *   agent -> driver:  COUNTER <name> <value>
+ *                     HISTOGRAM <name> <serialized histogram>
+ *                     END
+ *
+ * Times are CLOCK_REALTIME ns and durations are ns.  Every agent starts its
+ * workload at the same start time and stops it once the duration elapses, or
+ * earlier if the driver sends STOP; the agent then reports its results.
+ */
+class Agent {
+  public:
+    Agent(uint16_t port, void (*stopCallback)());
+    ~Agent();
+
+    void waitForStart();
+    void sendCounter(const char* name, uint64_t value);
+    void sendHistogram(const char* name, const Histogram& histogram);
+    void finish();
+
+  private:
+    /// Socket on which the agent accepts the driver's connection.
+    int listenFd;
+
+    /// Connection to the driver.
+    int controlFd;
+
+    /// Time at which the workload should stop.
+    uint64_t stopTimeNS;
+
+    /// Called once the workload should stop.
+    void (*stopCallback)();
+
+    /// Waits for the stop time or a STOP command.
+    std::thread stopWatcher;
+
+    void watchForStop();
+    bool readLine(std::string* line);
+    void writeLine(const std::string& line);
+
+    Agent(const Agent&);
+    Agent& operator=(const Agent&);
+};
+
+}  // namespace Kafkamark
+
+#endif  // KAFKAMARK_AGENT_H
@@ -0,0 +1,219 @@
+/* Copyright (c) 2017, Stanford University
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+ * OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "AllocStats.h"
+
+#include <fcntl.h>
+#include <malloc.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <atomic>
+
+#include "PerfUtils/Cycles.h"
+
+#include "TraceLog.h"
+
+using PerfUtils::Cycles;
+
+namespace Kafkamark {
+
+/// True while allocations should be counted.
+static std::atomic<bool> enabled(false);
+
+/// Number of successful allocations (including reallocations).
+static std::atomic<uint64_t> allocCount(0);
+
+/// Number of non-NULL frees (including reallocations).
+static std::atomic<uint64_t> freeCount(0);
+
+/// Usable bytes of all counted allocations.
+static std::atomic<uint64_t> allocBytes(0);
+
+/// Usable bytes of all counted frees.
+static std::atomic<uint64_t> freeBytes(0);
+
+uint64_t AllocStats::intervalTSC = 0;
+uint64_t AllocStats::nextSampleTSC = 0;
+
+/**
+ * Return true if allocations should currently be counted.
+ */
+static inline bool
+isCounting()
+{
+    return enabled.load(std::memory_order_relaxed);
+}
+
+/**
+ * Count an allocation of the provided block.
+ */
+static inline void
+countAlloc(void* ptr)
+{
+    if (ptr != NULL && isCounting()) {
+        allocCount.fetch_add(1, std::memory_order_relaxed);
+        allocBytes.fetch_add(malloc_usable_size(ptr),
+                             std::memory_order_relaxed);
+    }
+}
+
+/**
+ * Count the release of a block of the provided usable size.  Callers check
+ * isCounting() first, so that the block's size is only looked up while
+ * counting.
+ */
+static inline void
+countFree(size_t size)
+{
+    freeCount.fetch_add(1, std::memory_order_relaxed);
+    freeBytes.fetch_add(size, std::memory_order_relaxed);
+}
+
+/**
+ * Start counting allocations and record the initial sample.
+ *
+ * \param intervalMS
+ *      Minimum time, in milliseconds, between samples recorded by sample().
+ */
+void
+AllocStats::enable(uint64_t intervalMS)
+{
+    intervalTSC = Cycles::fromSeconds(static_cast<double>(intervalMS) / 1000);
+    enabled = true;
+    record(0);
+}
+
+/**
+ * Record a sample if the sampling interval has elapsed since the last one.
+ * Cheap enough to be called for every message.
+ *
+ * \param msgCount
+ *      Number of messages produced or consumed so far.
+ */
+void
+AllocStats::sample(uint64_t msgCount)
+{
+    if (!enabled.load(std::memory_order_relaxed)) {
+        return;
+    }
+    if (Cycles::rdtsc() >= nextSampleTSC) {
+        record(msgCount);
+    }
+}
+
+/**
+ * Record the current allocation counters and resident set size to the Trace
+ * Log, if enabled.
+ *
+ * \param msgCount
+ *      Number of messages produced or consumed so far.
+ */
+void
+AllocStats::record(uint64_t msgCount)
+{
+    if (!enabled.load(std::memory_order_relaxed)) {
+        return;
+    }
+    uint64_t now = Cycles::rdtsc();
+    nextSampleTSC = now + intervalTSC;
+    TraceLog::record(now, "ALLOC|%lu|%lu|%lu|%lu|%lu|%lu",
+            msgCount,
+            allocCount.load(std::memory_order_relaxed),
+            freeCount.load(std::memory_order_relaxed),
+            allocBytes.load(std::memory_order_relaxed),
+            freeBytes.load(std::memory_order_relaxed),
+            getRSS());
+}
+
+/**
+ * Return the resident set size of this process in bytes.  Does not allocate,
+ * so that sampling does not disturb the allocation counters.
+ */
+uint64_t
+AllocStats::getRSS()
+{
+    uint64_t size = 0;
+    uint64_t resident = 0;
+    char buf[128];
+    int fd = open("/proc/self/statm", O_RDONLY);
+    if (fd >= 0) {
+        ssize_t len = read(fd, buf, sizeof(buf) - 1);
+        if (len > 0) {
+            buf[len] = '\0';
+            if (sscanf(buf, "%lu %lu", &size, &resident) != 2) {
+                resident = 0;
+            }
+        }
+        close(fd);
+    }
+    return resident * sysconf(_SC_PAGESIZE);
+}
+
+}  // namespace Kafkamark
+
+using Kafkamark::countAlloc;
+using Kafkamark::countFree;
+using Kafkamark::isCounting;
+
+// Allocation wrappers; the linker's --wrap option redirects every reference
+// to e.g. malloc to __wrap_malloc, while __real_malloc refers to the original.
+extern "C" {
+
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+void __real_free(void* ptr);
+
+void*
+__wrap_malloc(size_t size)
+{
+    void* ptr = __real_malloc(size);
+    countAlloc(ptr);
+    return ptr;
+}
+
+void*
+__wrap_calloc(size_t count, size_t size)
+{
+    void* ptr = __real_calloc(count, size);
+    countAlloc(ptr);
+    return ptr;
+}
+
+void*
+__wrap_realloc(void* ptr, size_t size)
+{
+    bool counting = (ptr != NULL && isCounting());
+    size_t oldSize = counting ? malloc_usable_size(ptr) : 0;
+    void* newPtr = __real_realloc(ptr, size);
+    // The original block is left untouched if the reallocation failed.
+    if (counting && (newPtr != NULL || size == 0)) {
+        countFree(oldSize);
+    }
+    countAlloc(newPtr);
+    return newPtr;
+}
+
+void
+__wrap_free(void* ptr)
+{
+    if (ptr != NULL && isCounting()) {
+        countFree(malloc_usable_size(ptr));
+    }
+    __real_free(ptr);
+}
+
+}  // extern "C"
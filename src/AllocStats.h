@@ -0,0 +1,50 @@
+/* Copyright (c) 2017, Stanford University
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+ * OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef KAFKAMARK_ALLOCSTATS_H
+#define KAFKAMARK_ALLOCSTATS_H
+
+#include <stdint.h>
+
+namespace Kafkamark {
+
+/**
+ * Counts the heap allocations made by every thread in the process, including
+ * the client library's, and periodically records them to the Trace Log along
+ * with the process's resident set size.  The counters are maintained by
+ * malloc/calloc/realloc/free wrappers interposed at link time (see the
+ * Makefile) and only count while enabled.
+ */
+class AllocStats {
+  public:
+    static void enable(uint64_t intervalMS);
+    static void sample(uint64_t msgCount);
+    static void record(uint64_t msgCount);
+
+    static uint64_t getRSS();
+
+  private:
+    AllocStats();
+
+    /// Minimum number of cycles between recorded samples.
+    static uint64_t intervalTSC;
+
+    /// Time after which the next sample should be recorded.
+    static uint64_t nextSampleTSC;
+};
+
+}  // namespace Kafkamark
+
+#endif  // KAFKAMARK_ALLOCSTATS_H
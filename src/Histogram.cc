@@ -0,0 +1,124 @@
+/* Copyright (c) 2017, Stanford University
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+ * OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "Histogram.h"
+
+#include <sstream>
+
+namespace Kafkamark {
+
+/// log2(Histogram::SUB_BUCKETS)
+static const int SUB_BUCKET_BITS = 4;
+
+/// Number of buckets needed to cover all 64-bit values.
+static const size_t BUCKET_COUNT =
+        (64 - SUB_BUCKET_BITS + 1) * Histogram::SUB_BUCKETS;
+
+/**
+ * Construct an empty Histogram.
+ */
+Histogram::Histogram()
+    : count(0)
+    , min(0)
+    , max(0)
+    , sum(0)
+    , buckets(BUCKET_COUNT, 0)
+{
+}
+
+/**
+ * Record a value in the histogram.
+ */
+void
+Histogram::record(uint64_t value)
+{
+    if (count == 0 || value < min) {
+        min = value;
+    }
+    if (value > max) {
+        max = value;
+    }
+    ++count;
+    sum += value;
+    ++buckets[bucketIndex(value)];
+}
+
+/**
+ * Return (the lower bound of the bucket holding) the value below which the
+ * provided fraction of the recorded values fall.
+ *
+ * \param fraction
+ *      Fraction, in [0, 1], of the recorded values (e.g. 0.99).
+ */
+uint64_t
+Histogram::percentile(double fraction) const
+{
+    uint64_t rank = static_cast<uint64_t>(fraction * count);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < buckets.size(); ++i) {
+        seen += buckets[i];
+        if (seen > rank) {
+            return bucketLowerBound(i);
+        }
+    }
+    return max;
+}
+
+/**
+ * Return a single-line text representation of the histogram:
+ * "<count> <min> <max> <sum>" followed by an "<index>:<count>" pair for each
+ * non-empty bucket.
+ */
+std::string
+Histogram::serialize() const
+{
+    std::ostringstream out;
+    out << count << " " << min << " " << max << " " << sum;
+    for (size_t i = 0; i < buckets.size(); ++i) {
+        if (buckets[i] > 0) {
+            out << " " << i << ":" << buckets[i];
+        }
+    }
+    return out.str();
+}
+
+/**
+ * Return the index of the bucket holding the provided value.
+ */
+size_t
+Histogram::bucketIndex(uint64_t value)
+{
+    if (value < 2 * SUB_BUCKETS) {
+        return value;
+    }
+    int magnitude = 63 - __builtin_clzll(value);
+    int shift = magnitude - SUB_BUCKET_BITS;
+    return (shift + 1) * SUB_BUCKETS + ((value >> shift) - SUB_BUCKETS);
+}
+
+/**
+ * Return the smallest value held by the provided bucket.
+ */
+uint64_t
+Histogram::bucketLowerBound(size_t index)
+{
+    if (index < 2 * SUB_BUCKETS) {
+        return index;
+    }
+    int shift = index / SUB_BUCKETS - 1;
+    return (SUB_BUCKETS + index % SUB_BUCKETS) << shift;
+}
+
+}  // namespace Kafkamark
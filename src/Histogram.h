@@ -0,0 +1,66 @@
+/* Copyright (c) 2017, Stanford University
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+ * OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef KAFKAMARK_HISTOGRAM_H
+#define KAFKAMARK_HISTOGRAM_H
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+namespace Kafkamark {
+
+/**
+ * A log-linear histogram of non-negative integer values (e.g. latencies).
+ * Each power of two is split into SUB_BUCKETS equal buckets, so values are
+ * recorded with a relative error of at most 1/SUB_BUCKETS.  The bucket layout
+ * is fixed, so histograms recorded by different processes can be merged by
+ * adding their bucket counts.  This class is not thread-safe.
+ */
+class Histogram {
+  public:
+    /// Number of buckets each power of two is split into; a power of two.
+    static const uint64_t SUB_BUCKETS = 16;
+
+    Histogram();
+
+    void record(uint64_t value);
+    uint64_t percentile(double fraction) const;
+    std::string serialize() const;
+
+    static size_t bucketIndex(uint64_t value);
+    static uint64_t bucketLowerBound(size_t index);
+
+    /// Number of recorded values.
+    uint64_t count;
+
+    /// Smallest recorded value.
+    uint64_t min;
+
+    /// Largest recorded value.
+    uint64_t max;
+
+    /// Sum of all recorded values.
+    uint64_t sum;
+
+  private:
+    /// Number of recorded values in each bucket.
+    std::vector<uint64_t> buckets;
+};
+
+}  // namespace Kafkamark
+
+#endif  // KAFKAMARK_HISTOGRAM_H
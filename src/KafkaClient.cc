@@ -14,12 +14,41 @@
  */
 
 #include "KafkaClient.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <sstream>
+
 #include "PerfUtils/TimeTrace.h"
 
 using PerfUtils::TimeTrace;
 
 namespace Kafkamark {
 
+/**
+ * Return the provided string with all regular expression metacharacters
+ * escaped, so that it only matches itself within a pattern.
+ */
+static std::string
+escapeRegex(const std::string& str)
+{
+    std::string escaped;
+    for (size_t i = 0; i < str.size(); ++i) {
+        if (strchr("\\^$.|?*+()[]{}", str[i]) != NULL) {
+            escaped.push_back('\\');
+        }
+        escaped.push_back(str[i]);
+    }
+    return escaped;
+}
+
 /**
  * Construct a KafkaClient object with the provided options.
  */
@@ -32,7 +61,20 @@ KafkaClient::KafkaClient(KafkaClient::Mode mode)
     , tconf()
     , consumer()
     , producer()
-    , topic()
+    , topicName()
+    , topicCount(1)
+    , topicCache()
+    , transactional(false)
+    , fromBeginning(false)
+    , rebalanceHandler(this)
+    , eventDriven(false)
+    , eventTimerMS(0)
+    , epollFd(-1)
+    , timerFd(-1)
+    , consumerQueue(NULL)
+    , consumerQueueEvent()
+    , partitionQueueEvents()
+    , readyQueueEvents()
 {
     generalOptions.add_options()
         ("brokers,b",
@@ -41,6 +83,19 @@ KafkaClient::KafkaClient(KafkaClient::Mode mode)
         ("topic,t",
                 ProgramOptions::value< std::string >(),
                 "Topic to fetch / produce")
+        ("reply.topic",
+                ProgramOptions::value< std::string >(),
+                "Topic on which replies are exchanged in request/reply mode; "
+                "producers consume replies from it and consumers produce "
+                "replies to it")
+        ("topic.count",
+                ProgramOptions::value< size_t >()->default_value(1),
+                "Number of topics to spread load over; when greater than 1 "
+                "the topics are named <topic>-0 ... <topic>-<N-1>")
+        ("topic.metadata.refresh.interval.ms",
+                ProgramOptions::value< std::string >(),
+                "Topic metadata refresh interval in milliseconds. "
+                "*Type: integer*")
         ("group.id,g",
                 ProgramOptions::value< std::string >(),
                 "Client group id string. All clients sharing the same group.id "
@@ -57,6 +112,15 @@ KafkaClient::KafkaClient(KafkaClient::Mode mode)
                 "How long to postpone the next fetch request for a "
                 "topic+partition in case of a fetch error. "
                 "*Type: integer*")
+        ("auto.offset.reset",
+                ProgramOptions::value< std::string >(),
+                "Action to take when there is no initial offset in offset "
+                "store or the desired offset is out of range. "
+                "*Type: enum value*")
+        ("isolation.level",
+                ProgramOptions::value< std::string >(),
+                "Controls how to read messages written transactionally: "
+                "read_committed or read_uncommitted. *Type: enum value*")
     ;
 
     producerOptions.add_options()
@@ -68,6 +132,21 @@ KafkaClient::KafkaClient(KafkaClient::Mode mode)
                 ProgramOptions::value< std::string >(),
                 "Maximum time, in milliseconds, for buffering data on the "
                 "producer queue. *Type: integer*")
+        ("acks",
+                ProgramOptions::value< std::string >(),
+                "Number of acknowledgements the leader broker must receive "
+                "from ISR brokers before responding to the request. "
+                "*Type: integer*")
+        ("enable.idempotence",
+                ProgramOptions::value< std::string >(),
+                "When set to true, the producer will ensure that messages are "
+                "successfully produced exactly once and in the original "
+                "produce order. *Type: boolean*")
+        ("transactional.id",
+                ProgramOptions::value< std::string >(),
+                "Enables the transactional producer. Used to identify the "
+                "same transactional producer instance across process "
+                "restarts. *Type: string*")
     ;
 }
 
@@ -78,12 +157,27 @@ KafkaClient::~KafkaClient()
 {
     if (consumer) {
         consumer->close();
+        closePartitionQueues();
+        if (consumerQueue) {
+            rd_kafka_queue_io_event_enable(consumerQueue, -1, NULL, 0);
+            rd_kafka_queue_destroy(consumerQueue);
+            close(consumerQueueEvent.fd);
+            close(consumerQueueEvent.writeFd);
+        }
         delete consumer;
     }
+    if (timerFd >= 0) {
+        close(timerFd);
+    }
+    if (epollFd >= 0) {
+        close(epollFd);
+    }
     if (producer) {
         producer->flush(10*1000);
-        if (topic) {
-            delete topic;
+        for (size_t i = 0; i < topicCache.size(); ++i) {
+            if (topicCache[i]) {
+                delete topicCache[i];
+            }
         }
         delete producer;
     }
@@ -97,15 +191,44 @@ KafkaClient::addOptionsTo(OptionsDescription& options)
 {
     options.add(generalOptions);
 
-    if (mode & CONSUMER) {
+    if (mode & (CONSUMER | REPLY)) {
         options.add(consumerOptions);
     }
 
-    if (mode & PRODUCER) {
+    if (mode & (PRODUCER | REPLY)) {
         options.add(producerOptions);
     }
 }
 
+/**
+ * Switch the consumer to event-driven mode, in which each assigned partition
+ * is served from its own queue whose readiness is signaled on a file
+ * descriptor, and all queues are multiplexed with epoll from a single thread
+ * using waitForEvents() and consumeReady().  Must be called before configure().
+ *
+ * \param timerMS
+ *      Interval, in ms, of a housekeeping timer multiplexed with the queues,
+ *      on whose ticks waitForEvents() also returns.
+ */
+void
+KafkaClient::enableEvents(int timerMS)
+{
+    eventDriven = true;
+    eventTimerMS = timerMS;
+}
+
+/**
+ * Make the consumer start from the earliest offset of every partition,
+ * regardless of auto.offset.reset or of offsets committed by its group.id,
+ * by joining a freshly named consumer group.  Must be called before
+ * configure().
+ */
+void
+KafkaClient::consumeFromBeginning()
+{
+    fromBeginning = true;
+}
+
 /**
  * Configure the client with the provided options.  Must be called before the
  * client can be used to produce or consume.
@@ -118,6 +241,8 @@ KafkaClient::configure(ProgramOptions::variables_map& variables)
 {
     std::string errstr;
     std::string topic_str;
+    std::string consume_topic_str;
+    std::string produce_topic_str;
 
     // Create kafka configuration
     conf = RdKafka::Conf::create(RdKafka::Conf::CONF_GLOBAL);
@@ -144,22 +269,82 @@ KafkaClient::configure(ProgramOptions::variables_map& variables)
         exit(1);
     }
 
-    setConfig(variables, "group.id");
+    // In request/reply mode each client also takes on the opposite role for
+    // the reply topic.
+    bool isConsumer = mode & CONSUMER;
+    bool isProducer = mode & PRODUCER;
+    bool isRequester = false;
+    consume_topic_str = topic_str;
+    produce_topic_str = topic_str;
+    if ((mode & REPLY) && variables.count("reply.topic")) {
+        std::string reply_topic_str =
+                variables.at("reply.topic").as<std::string>();
+        if (!isConsumer) {
+            consume_topic_str = reply_topic_str;
+            isRequester = true;
+        }
+        if (!isProducer) {
+            produce_topic_str = reply_topic_str;
+        }
+        isConsumer = true;
+        isProducer = true;
+    }
+
+    // Load is only spread over multiple topics on the main topic.
+    size_t topic_count = variables.at("topic.count").as<size_t>();
+    if (topic_count == 0) {
+        std::cerr << "Couldn't construct client: topic.count must be at "
+                  << "least 1."
+                  << std::endl;
+        exit(1);
+    }
+    if (topic_count > 1 && consume_topic_str == topic_str) {
+        consume_topic_str = "^" + escapeRegex(topic_str) + "-[0-9]+$";
+    }
+    if (produce_topic_str == topic_str) {
+        topicCount = topic_count;
+    }
+    topicName = produce_topic_str;
+
+    if (isConsumer && (fromBeginning || isRequester)) {
+        // A group without committed offsets starts at auto.offset.reset.
+        // A requester must see every reply and must not rebalance the
+        // responders' group, so it also gets a group of its own.
+        std::ostringstream group_id;
+        group_id << "kafkamark-" << getpid() << "-" << time(NULL);
+        conf->set("group.id", group_id.str(), errstr);
+    } else {
+        setConfig(variables, "group.id");
+    }
+    setConfig(variables, "topic.metadata.refresh.interval.ms");
 
     // Consumer configuration
-    if (mode & CONSUMER) {
+    if (isConsumer) {
         setConfig(variables, "fetch.wait.max.ms");
         setConfig(variables, "fetch.error.backoff.ms");
+        setConfig(variables, "isolation.level");
+        if (fromBeginning) {
+            tconf->set("auto.offset.reset", "earliest", errstr);
+        } else {
+            setTopicConfig(variables, "auto.offset.reset");
+        }
+        conf->set("default_topic_conf", tconf, errstr);
+        if (eventDriven) {
+            conf->set("rebalance_cb", &rebalanceHandler, errstr);
+        }
     }
 
     // Producer configuration
-    if (mode & PRODUCER) {
+    if (isProducer) {
         setConfig(variables, "queue.buffering.max.messages");
         setConfig(variables, "queue.buffering.max.ms");
+        setConfig(variables, "acks");
+        setConfig(variables, "enable.idempotence");
+        transactional = setConfig(variables, "transactional.id");
     }
 
     // Consumer setup
-    if (mode & CONSUMER) {
+    if (isConsumer) {
         // Create consumer
         consumer = RdKafka::KafkaConsumer::create(conf, errstr);
         if (!consumer) {
@@ -167,9 +352,13 @@ KafkaClient::configure(ProgramOptions::variables_map& variables)
             exit(1);
         }
 
+        if (eventDriven) {
+            setupEvents();
+        }
+
         // Subscribe to topics
         std::vector<std::string> topics;
-        topics.push_back(topic_str);
+        topics.push_back(consume_topic_str);
         RdKafka::ErrorCode err = consumer->subscribe(topics);
         if (err) {
             std::cerr << "Failed to subscribe to "
@@ -182,7 +371,7 @@ KafkaClient::configure(ProgramOptions::variables_map& variables)
     }
 
     // Producer Setup
-    if (mode & PRODUCER) {
+    if (isProducer) {
         // Create producer
         producer = RdKafka::Producer::create(conf, errstr);
         if (!producer) {
@@ -190,13 +379,57 @@ KafkaClient::configure(ProgramOptions::variables_map& variables)
              exit(1);
         }
 
-        // Create topic handle
-        topic = RdKafka::Topic::create(producer, topic_str, tconf, errstr);
-        if (!topic) {
-          std::cerr << "Failed to create topic: " << errstr << std::endl;
-          exit(1);
+        // Create the first topic handle; the rest are created on first use
+        topicCache.resize(topicCount);
+        getTopic(0);
+
+        // Register the transactional id with the transaction coordinator
+        if (transactional) {
+#if RD_KAFKA_VERSION >= 0x010400ff
+            RdKafka::Error* error = producer->init_transactions(30*1000);
+            if (error) {
+                std::cerr << "Failed to init transactions: "
+                          << error->str()
+                          << std::endl;
+                delete error;
+                exit(1);
+            }
+#else
+            std::cerr << "Failed to init transactions: "
+                      << "librdkafka v1.4.0 or later is required."
+                      << std::endl;
+            exit(1);
+#endif
+        }
+    }
+}
+
+/**
+ * Wait until the consumer has been assigned partitions by its group, so that
+ * nothing produced afterwards is missed.  Any messages consumed while waiting
+ * are discarded.
+ *
+ * \param timeout_ms
+ *      Maximum number of ms to wait for the assignment.
+ * \return
+ *      True, if the consumer has assigned partitions.  False, otherwise.
+ */
+bool
+KafkaClient::waitForAssignment(int timeout_ms)
+{
+    for (int waited = 0; waited <= timeout_ms; waited += 100) {
+        std::vector<RdKafka::TopicPartition*> partitions;
+        RdKafka::ErrorCode err = consumer->assignment(partitions);
+        bool assigned = (!err && !partitions.empty());
+        RdKafka::TopicPartition::destroy(partitions);
+        if (assigned) {
+            return true;
         }
+
+        // The group join and assignment are served from consume().
+        delete consumer->consume(100);
     }
+    return false;
 }
 
 /**
@@ -214,8 +447,114 @@ KafkaClient::configure(ProgramOptions::variables_map& variables)
  bool
  KafkaClient::consume(KafkaClient::Message* msg, int timeout_ms)
  {
-    RdKafka::Message* message = consumer->consume(timeout_ms);
+    return handleMessage(consumer->consume(timeout_ms), msg);
+ }
+
+/**
+ * Wait until at least one of the consumer's queues has messages or events
+ * ready, or until the housekeeping timer ticks.  Returns immediately if
+ * queues are still ready from before.  Only available once enableEvents()
+ * has been called.
+ *
+ * \param timeout_ms
+ *      Maximum number of ms to wait; -1 waits until the next event or tick.
+ * \param timerTicks
+ *      Incremented by the number of timer ticks since the last call.
+ * \return
+ *      The number of queues ready to be served with consumeReady().
+ */
+int
+KafkaClient::waitForEvents(int timeout_ms, uint64_t* timerTicks)
+{
+    if (!readyQueueEvents.empty()) {
+        timeout_ms = 0;
+    }
+
+    struct epoll_event events[64];
+    int count = epoll_wait(epollFd, events, 64, timeout_ms);
+    if (count < 0) {
+        if (errno != EINTR) {
+            std::cerr << "Failed to wait for consumer events: "
+                      << strerror(errno)
+                      << std::endl;
+            exit(1);
+        }
+        count = 0;
+    }
+
+    for (int i = 0; i < count; ++i) {
+        QueueEvent* queueEvent = static_cast<QueueEvent*>(events[i].data.ptr);
+        if (queueEvent == NULL) {
+            uint64_t expirations;
+            if (read(timerFd, &expirations, sizeof(expirations)) > 0) {
+                *timerTicks += expirations;
+            }
+            continue;
+        }
+
+        char buf[64];
+        while (read(queueEvent->fd, buf, sizeof(buf)) > 0);
+        if (!queueEvent->ready) {
+            queueEvent->ready = true;
+            readyQueueEvents.push_back(queueEvent);
+        }
+    }
+    return readyQueueEvents.size();
+}
+
+/**
+ * Consume a message, without blocking, from the queues that waitForEvents()
+ * found ready.  Each ready queue is drained before the next one is served.
+ *
+ * \param msg
+ *      Pointer to the KafkaClient::Message handler which will have access to
+ *      the acquired message.
+ * \return
+ *      True, if a message was found without error.  False, once all ready
+ *      queues have been drained.
+ */
+bool
+KafkaClient::consumeReady(KafkaClient::Message* msg)
+{
+    while (!readyQueueEvents.empty()) {
+        QueueEvent* queueEvent = readyQueueEvents.front();
+        RdKafka::Message* message;
+        if (queueEvent->queue) {
+            message = queueEvent->queue->consume(0);
+        } else {
+            // Also serves rebalance callbacks, which may modify the queues.
+            message = consumer->consume(0);
+        }
+
+        bool drained = (message->err() == RdKafka::ERR__TIMED_OUT);
+        if (handleMessage(message, msg)) {
+            return true;
+        }
+        if (drained && !readyQueueEvents.empty() &&
+                readyQueueEvents.front() == queueEvent) {
+            queueEvent->ready = false;
+            readyQueueEvents.pop_front();
+        }
+    }
+    return false;
+}
 
+/**
+ * Make the message acquired from librdkafka accessible from the provided
+ * KafkaClient::Message pointer, or dispose of it if it is not a message.
+ *
+ * \param message
+ *      Message or event returned by librdkafka.
+ * \param msg
+ *      Pointer to the KafkaClient::Message handler which will have access to
+ *      the message.
+ * \return
+ *      True, if the message was a message without error.  False, otherwise.
+ */
+bool
+KafkaClient::handleMessage(RdKafka::Message* message,
+        KafkaClient::Message* msg)
+{
     switch (message->err()) {
         case RdKafka::ERR_NO_ERROR:
             msg->message = message;
@@ -239,7 +578,7 @@ KafkaClient::configure(ProgramOptions::variables_map& variables)
 
     delete message;
     return false;
- }
+}
 
 /**
  * Produce the provided message to the configured Kafka topic.
@@ -248,18 +587,29 @@ KafkaClient::configure(ProgramOptions::variables_map& variables)
  *      Message that should be published to the client's configured topic.
  * \param len
  *      Length of the message to be published.
+ * \param topicIndex
+ *      Index of the topic, in [0, getTopicCount()), the message should be
+ *      published to.
+ * \param partition
+ *      Partition the message should be published to; -1 lets the configured
+ *      partitioner choose.
+ * \param key
+ *      Message key, or NULL if the message has no key.
+ * \param keyLen
+ *      Length of the message key.
  * \return
  *      True, if the messages produced without error.  False, otherwise.
  */
 bool
-KafkaClient::produce(char* msg, size_t len)
+KafkaClient::produce(char* msg, size_t len, size_t topicIndex,
+        int32_t partition, const void* key, size_t keyLen)
 {
-    int partition = 0;
+    RdKafka::Topic* topic = getTopic(topicIndex);
     RdKafka::ErrorCode resp;
     do {
         TimeTrace::record("...try produce...");
         resp = producer->produce(topic, partition,
-                RdKafka::Producer::RK_MSG_COPY, msg, len, NULL, NULL);
+                RdKafka::Producer::RK_MSG_COPY, msg, len, key, keyLen, NULL);
     } while (resp == RdKafka::ERR__QUEUE_FULL);
 
     if (resp != RdKafka::ERR_NO_ERROR) {
@@ -271,6 +621,331 @@ KafkaClient::produce(char* msg, size_t len)
     return true;
 }
 
+/**
+ * Return the number of topics the producer spreads its messages over.
+ */
+size_t
+KafkaClient::getTopicCount()
+{
+    return topicCount;
+}
+
+/**
+ * Create the handles for all of the producer's topics up front rather than
+ * on first use.
+ */
+void
+KafkaClient::openTopics()
+{
+    for (size_t i = 0; i < topicCount; ++i) {
+        getTopic(i);
+    }
+}
+
+/**
+ * Request metadata for all topics in the cluster from the brokers.
+ *
+ * \param timeout_ms
+ *      Maximum number of ms to wait for the metadata response.
+ * \return
+ *      True, if the metadata was received without error.  False, otherwise.
+ */
+bool
+KafkaClient::refreshMetadata(int timeout_ms)
+{
+    RdKafka::Metadata* metadata;
+    RdKafka::ErrorCode err = producer->metadata(true, NULL, &metadata,
+            timeout_ms);
+    if (err != RdKafka::ERR_NO_ERROR) {
+        std::cerr << "% Metadata request failed: "
+                  << RdKafka::err2str(err)
+                  << std::endl;
+        return false;
+    }
+    delete metadata;
+    return true;
+}
+
+/**
+ * Begin a new transaction.  Must only be called on a client configured with a
+ * transactional.id; all messages produced until the matching
+ * commitTransaction() call are part of the transaction.
+ *
+ * \return
+ *      True, if the transaction began without error.  False, otherwise.
+ */
+bool
+KafkaClient::beginTransaction()
+{
+#if RD_KAFKA_VERSION >= 0x010400ff
+    RdKafka::Error* error = producer->begin_transaction();
+    if (error) {
+        std::cerr << "% Begin transaction failed: "
+                  << error->str()
+                  << std::endl;
+        delete error;
+        return false;
+    }
+    return true;
+#else
+    std::cerr << "% Begin transaction failed: "
+              << "librdkafka v1.4.0 or later is required."
+              << std::endl;
+    return false;
+#endif
+}
+
+/**
+ * Commit the current transaction, flushing any outstanding messages.  The
+ * transaction is aborted if it cannot be committed.
+ *
+ * \param timeout_ms
+ *      Maximum number of ms to wait for the commit to complete.
+ * \return
+ *      True, if the transaction committed without error.  False, otherwise.
+ */
+bool
+KafkaClient::commitTransaction(int timeout_ms)
+{
+#if RD_KAFKA_VERSION >= 0x010400ff
+    RdKafka::Error* error = producer->commit_transaction(timeout_ms);
+    if (error) {
+        std::cerr << "% Commit transaction failed: "
+                  << error->str()
+                  << std::endl;
+        if (error->txn_requires_abort()) {
+            delete error;
+            error = producer->abort_transaction(timeout_ms);
+        }
+        delete error;
+        return false;
+    }
+    return true;
+#else
+    std::cerr << "% Commit transaction failed: "
+              << "librdkafka v1.4.0 or later is required."
+              << std::endl;
+    return false;
+#endif
+}
+
+/**
+ * Wait for all outstanding produce requests to complete.
+ *
+ * \param timeout_ms
+ *      Maximum number of ms to wait for the outstanding requests.
+ * \return
+ *      True, if all outstanding requests completed.  False, otherwise.
+ */
+bool
+KafkaClient::flush(int timeout_ms)
+{
+    return producer->flush(timeout_ms) == RdKafka::ERR_NO_ERROR;
+}
+
+/**
+ * Query the brokers for the number of messages the consumer has yet to
+ * consume across all of its currently assigned partitions.
+ *
+ * \param timeout_ms
+ *      Maximum number of ms to wait for each partition's watermark query.
+ * \return
+ *      The total number of messages between the consumer's position and the
+ *      high watermark of each assigned partition; -1 if the consumer has no
+ *      assigned partitions or the lag could not be determined.
+ */
+int64_t
+KafkaClient::getLag(int timeout_ms)
+{
+    std::vector<RdKafka::TopicPartition*> partitions;
+    RdKafka::ErrorCode err = consumer->assignment(partitions);
+    if (err || partitions.empty()) {
+        RdKafka::TopicPartition::destroy(partitions);
+        return -1;
+    }
+
+    int64_t lag = 0;
+    consumer->position(partitions);
+    for (size_t i = 0; i < partitions.size(); ++i) {
+        int64_t low;
+        int64_t high;
+        err = consumer->query_watermark_offsets(partitions[i]->topic(),
+                partitions[i]->partition(), &low, &high, timeout_ms);
+        if (err) {
+            lag = -1;
+            break;
+        }
+
+        // The position is invalid until the first fetch for the partition
+        // completes, in which case the whole partition is outstanding.
+        int64_t position = partitions[i]->offset();
+        if (position < low) {
+            position = low;
+        }
+        lag += high - position;
+    }
+
+    RdKafka::TopicPartition::destroy(partitions);
+    return lag;
+}
+
+/**
+ * Create the epoll instance used in event-driven mode and register the
+ * housekeeping timer and the consumer's own queue with it.
+ */
+void
+KafkaClient::setupEvents()
+{
+    epollFd = epoll_create1(0);
+    timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+    int fds[2];
+    if (epollFd < 0 || timerFd < 0 || pipe2(fds, O_NONBLOCK) < 0) {
+        std::cerr << "Failed to set up consumer events." << std::endl;
+        exit(1);
+    }
+
+    struct itimerspec interval;
+    interval.it_interval.tv_sec = eventTimerMS / 1000;
+    interval.it_interval.tv_nsec = (eventTimerMS % 1000) * 1000000;
+    interval.it_value = interval.it_interval;
+    timerfd_settime(timerFd, 0, &interval, NULL);
+
+    // The timer has no QueueEvent of its own.
+    struct epoll_event timerEvent;
+    timerEvent.events = EPOLLIN;
+    timerEvent.data.ptr = NULL;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, timerFd, &timerEvent);
+
+    consumerQueueEvent.fd = fds[0];
+    consumerQueueEvent.writeFd = fds[1];
+
+    // The C++ API has no handle to the consumer's queue.  The queue is still
+    // served through consumer->consume() so that rebalance callbacks run;
+    // the handle only enables its events.
+    consumerQueue = rd_kafka_queue_get_consumer(consumer->c_ptr());
+    rd_kafka_queue_io_event_enable(consumerQueue, consumerQueueEvent.writeFd,
+            "1", 1);
+
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.ptr = &consumerQueueEvent;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, consumerQueueEvent.fd, &event);
+
+    // Events may have been queued before they were enabled.
+    consumerQueueEvent.ready = true;
+    readyQueueEvents.push_back(&consumerQueueEvent);
+}
+
+/**
+ * Serve each of the provided partitions from its own queue, which signals on
+ * a pipe registered with epoll whenever it becomes non-empty.
+ *
+ * \param partitions
+ *      Partitions newly assigned to the consumer.
+ */
+void
+KafkaClient::openPartitionQueues(
+        const std::vector<RdKafka::TopicPartition*>& partitions)
+{
+    for (size_t i = 0; i < partitions.size(); ++i) {
+        QueueEvent* queueEvent = new QueueEvent();
+        int fds[2];
+        if (pipe2(fds, O_NONBLOCK) < 0) {
+            std::cerr << "Failed to create queue event pipe." << std::endl;
+            exit(1);
+        }
+        queueEvent->fd = fds[0];
+        queueEvent->writeFd = fds[1];
+
+        // Stop forwarding to the consumer queue so the partition's messages
+        // are only available from, and signaled by, its own queue.
+        queueEvent->queue = consumer->get_partition_queue(partitions[i]);
+        queueEvent->queue->forward(NULL);
+        queueEvent->queue->io_event_enable(queueEvent->writeFd, "1", 1);
+
+        struct epoll_event event;
+        event.events = EPOLLIN;
+        event.data.ptr = queueEvent;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, queueEvent->fd, &event);
+
+        // Messages may have been queued before the events were enabled.
+        queueEvent->ready = true;
+        readyQueueEvents.push_back(queueEvent);
+        partitionQueueEvents.push_back(queueEvent);
+    }
+}
+
+/**
+ * Release all of the per-partition queues created by openPartitionQueues().
+ */
+void
+KafkaClient::closePartitionQueues()
+{
+    for (size_t i = 0; i < partitionQueueEvents.size(); ++i) {
+        QueueEvent* queueEvent = partitionQueueEvents[i];
+        queueEvent->queue->io_event_enable(-1, NULL, 0);
+        delete queueEvent->queue;
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, queueEvent->fd, NULL);
+        close(queueEvent->fd);
+        close(queueEvent->writeFd);
+        readyQueueEvents.erase(std::remove(readyQueueEvents.begin(),
+                                           readyQueueEvents.end(),
+                                           queueEvent),
+                               readyQueueEvents.end());
+        delete queueEvent;
+    }
+    partitionQueueEvents.clear();
+}
+
+/**
+ * Called by librdkafka when the consumer's partition assignment changes in
+ * event-driven mode.
+ */
+void
+KafkaClient::RebalanceHandler::rebalance_cb(RdKafka::KafkaConsumer* consumer,
+        RdKafka::ErrorCode err,
+        std::vector<RdKafka::TopicPartition*>& partitions)
+{
+    if (err == RdKafka::ERR__ASSIGN_PARTITIONS) {
+        consumer->assign(partitions);
+        client->openPartitionQueues(partitions);
+    } else {
+        client->closePartitionQueues();
+        consumer->unassign();
+    }
+}
+
+/**
+ * Return the cached handle for a producer topic, creating the handle the first
+ * time the topic is used.
+ *
+ * \param index
+ *      Index of the topic, in [0, topicCount), whose handle should be
+ *      returned.
+ */
+RdKafka::Topic*
+KafkaClient::getTopic(size_t index)
+{
+    RdKafka::Topic* topic = topicCache[index];
+    if (!topic) {
+        std::string name = topicName;
+        if (topicCount > 1) {
+            std::ostringstream suffix;
+            suffix << "-" << index;
+            name.append(suffix.str());
+        }
+
+        std::string errstr;
+        topic = RdKafka::Topic::create(producer, name, tconf, errstr);
+        if (!topic) {
+          std::cerr << "Failed to create topic: " << errstr << std::endl;
+          exit(1);
+        }
+        topicCache[index] = topic;
+    }
+    return topic;
+}
+
 /**
  * Helper function to set the client library configuration based on provided
  * option values.
@@ -300,4 +975,33 @@ KafkaClient::setConfig(ProgramOptions::variables_map& variables,
     return false;
 }
 
+/**
+ * Helper function to set the topic configuration based on provided option
+ * values.
+ *
+ * \param variables
+ *      Contains the option value that should be set.
+ * \param optionName
+ *      Name of the topic config option that should be set.
+ * \return
+ *      True, if the option was set. False, otherwise.
+ */
+bool
+KafkaClient::setTopicConfig(ProgramOptions::variables_map& variables,
+        const char* optionName)
+{
+    std::string errstr;
+    if (variables.count(optionName)) {
+        tconf->set(optionName,
+                variables.at(optionName).as<std::string>(),
+                errstr);
+        if (errstr == "") {
+            return true;
+        } else {
+            std::cerr << errstr << std::endl;
+        }
+    }
+    return false;
+}
+
 }   // namespace Kafkamark
@@ -16,7 +16,12 @@
 #ifndef KAFKAMARK_KAFKACLIENT_H
 #define KAFKAMARK_KAFKACLIENT_H
 
+#include <deque>
+#include <string>
+#include <vector>
+
 #include <boost/program_options.hpp>
+#include <librdkafka/rdkafka.h>
 #include <librdkafka/rdkafkacpp.h>
 
 namespace Kafkamark {
@@ -40,6 +45,9 @@ class KafkaClient {
     enum Mode {
         CONSUMER = 1 << 0,
         PRODUCER = 1 << 1,
+        /// The client also takes on the opposite role when a reply.topic is
+        /// configured (i.e. request/reply mode).
+        REPLY = 1 << 2,
     };
 
     /**
@@ -80,10 +88,70 @@ class KafkaClient {
     void addOptionsTo(OptionsDescription& options);
     void configure(ProgramOptions::variables_map& variables);
 
+    void enableEvents(int timerMS);
+    void consumeFromBeginning();
+
+    bool waitForAssignment(int timeout_ms);
     bool consume(Message* msg, int timeout_ms);
-    bool produce(char* msg, size_t len);
+    int waitForEvents(int timeout_ms, uint64_t* timerTicks);
+    bool consumeReady(Message* msg);
+    bool produce(char* msg, size_t len, size_t topicIndex = 0,
+            int32_t partition = 0, const void* key = NULL, size_t keyLen = 0);
+    bool flush(int timeout_ms);
+
+    size_t getTopicCount();
+    void openTopics();
+    bool refreshMetadata(int timeout_ms);
+
+    bool beginTransaction();
+    bool commitTransaction(int timeout_ms);
+
+    int64_t getLag(int timeout_ms);
 
   private:
+    /**
+     * Tracks a consumer queue served in event-driven mode.
+     */
+    struct QueueEvent {
+        QueueEvent()
+            : queue(NULL)
+            , fd(-1)
+            , writeFd(-1)
+            , ready(false)
+        {}
+
+        /// Partition queue; NULL for the consumer's own queue.
+        RdKafka::Queue* queue;
+
+        /// File descriptor registered with epoll for this queue.
+        int fd;
+
+        /// File descriptor librdkafka writes to when the queue is non-empty.
+        int writeFd;
+
+        /// True if the queue is on the ready list.
+        bool ready;
+    };
+
+    /**
+     * Sets up a partition queue for each newly assigned partition in
+     * event-driven mode.
+     */
+    class RebalanceHandler : public RdKafka::RebalanceCb {
+      public:
+        explicit RebalanceHandler(KafkaClient* client)
+            : client(client)
+        {}
+
+        void rebalance_cb(RdKafka::KafkaConsumer* consumer,
+                RdKafka::ErrorCode err,
+                std::vector<RdKafka::TopicPartition*>& partitions);
+
+      private:
+        /// Client whose partition queues are managed.
+        KafkaClient* client;
+    };
+
     /// Mode which the client should run.
     Mode mode;
 
@@ -108,11 +176,62 @@ class KafkaClient {
     /// Handle to Kafka producer client.
     RdKafka::Producer *producer;
 
-    /// Handle to Kafka topic.
-    RdKafka::Topic *topic;
+    /// Name of the topic (or topic name prefix if topicCount > 1) that the
+    /// producer publishes to.
+    std::string topicName;
+
+    /// Number of topics the producer spreads its messages over.
+    size_t topicCount;
+
+    /// Handles to the producer's Kafka topics, indexed by topic number and
+    /// created on first use so that each is only ever created once.
+    std::vector<RdKafka::Topic*> topicCache;
+
+    /// True if the producer was configured with a transactional.id.
+    bool transactional;
+
+    /// True if the consumer should start from the earliest offset of every
+    /// partition in a consumer group of its own.
+    bool fromBeginning;
+
+    /// Rebalance callback used in event-driven mode.
+    RebalanceHandler rebalanceHandler;
 
+    /// True if the consumer runs in event-driven mode.
+    bool eventDriven;
+
+    /// Housekeeping timer interval in ms in event-driven mode.
+    int eventTimerMS;
+
+    /// Epoll instance multiplexing the consumer queues in event-driven mode.
+    int epollFd;
+
+    /// Housekeeping timer multiplexed with the consumer queues.
+    int timerFd;
+
+    /// Handle to the consumer's own queue, which carries rebalances and other
+    /// events, in event-driven mode.
+    rd_kafka_queue_t* consumerQueue;
+
+    /// Tracks the consumer's own queue.
+    QueueEvent consumerQueueEvent;
+
+    /// Tracks the queue of each assigned partition.
+    std::vector<QueueEvent*> partitionQueueEvents;
+
+    /// Queues that may have messages or events ready, in the order found.
+    std::deque<QueueEvent*> readyQueueEvents;
+
+    bool handleMessage(RdKafka::Message* message, Message* msg);
+    void setupEvents();
+    void openPartitionQueues(
+            const std::vector<RdKafka::TopicPartition*>& partitions);
+    void closePartitionQueues();
+    RdKafka::Topic* getTopic(size_t index);
     bool setConfig(ProgramOptions::variables_map& variables,
             const char* optionName);
+    bool setTopicConfig(ProgramOptions::variables_map& variables,
+            const char* optionName);
 };
 
 /**
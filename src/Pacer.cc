@@ -0,0 +1,68 @@
+/* Copyright (c) 2017, Stanford University
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+ * OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "Pacer.h"
+
+#include <sys/prctl.h>
+#include <time.h>
+
+#include "PerfUtils/Cycles.h"
+
+using PerfUtils::Cycles;
+
+namespace Kafkamark {
+
+/**
+ * Construct a Pacer for the calling thread.
+ *
+ * \param spinNS
+ *      Gaps of at most this many ns are spun rather than slept; it should
+ *      cover the scheduler's wakeup latency.
+ */
+Pacer::Pacer(uint64_t spinNS)
+    : spinTSC(Cycles::fromNanoseconds(spinNS))
+{
+    // The default 50us timer slack would otherwise dominate the wakeup
+    // error of short sleeps.
+    prctl(PR_SET_TIMERSLACK, 1UL, 0UL, 0UL, 0UL);
+}
+
+/**
+ * Wait until the provided TSC time.
+ *
+ * \param targetTSC
+ *      The TSC time to wait until; returns immediately if it already passed.
+ * \return
+ *      The TSC time at which the wait ended.
+ */
+uint64_t
+Pacer::waitUntil(uint64_t targetTSC)
+{
+    uint64_t now = Cycles::rdtsc();
+    if (targetTSC > now + spinTSC) {
+        uint64_t sleepNS = Cycles::toNanoseconds(targetTSC - now - spinTSC);
+        struct timespec duration;
+        duration.tv_sec = sleepNS / 1000000000;
+        duration.tv_nsec = sleepNS % 1000000000;
+        nanosleep(&duration, NULL);
+        now = Cycles::rdtsc();
+    }
+    while (now < targetTSC) {
+        now = Cycles::rdtsc();
+    }
+    return now;
+}
+
+}  // namespace Kafkamark
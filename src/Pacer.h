@@ -0,0 +1,41 @@
+/* Copyright (c) 2017, Stanford University
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+ * OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef KAFKAMARK_PACER_H
+#define KAFKAMARK_PACER_H
+
+#include <stdint.h>
+
+namespace Kafkamark {
+
+/**
+ * Waits until a scheduled TSC time without burning a core for long gaps: the
+ * calling thread sleeps until shortly before the scheduled time and only
+ * spins for the final stretch.  This class is not thread-safe.
+ */
+class Pacer {
+  public:
+    explicit Pacer(uint64_t spinNS);
+
+    uint64_t waitUntil(uint64_t targetTSC);
+
+  private:
+    /// Gaps shorter than this many cycles are spun rather than slept.
+    uint64_t spinTSC;
+};
+
+}  // namespace Kafkamark
+
+#endif  // KAFKAMARK_PACER_H
@@ -0,0 +1,123 @@
+/* Copyright (c) 2017, Stanford University
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+ * OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "ReplayTrace.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <iostream>
+
+namespace Kafkamark {
+
+/// Number of bytes replayed before the pages holding them are released.
+static const size_t RELEASE_BYTES = 64 << 20;
+
+/**
+ * Open and map the trace file at the provided path.  Exits if the file is not
+ * a valid trace.
+ *
+ * \param filePath
+ *      The path of the trace file that should be replayed.
+ */
+ReplayTrace::ReplayTrace(const char* filePath)
+    : fd(-1)
+    , base(NULL)
+    , length(0)
+    , offset(sizeof(Header))
+    , releasedOffset(0)
+{
+    fd = open(filePath, O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Failed to open trace: " << filePath << std::endl;
+        exit(1);
+    }
+
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) < 0 ||
+            static_cast<size_t>(fileStat.st_size) < sizeof(Header)) {
+        std::cerr << "Failed to read trace: " << filePath << std::endl;
+        exit(1);
+    }
+    length = fileStat.st_size;
+
+    void* addr = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (addr == MAP_FAILED) {
+        std::cerr << "Failed to map trace: " << filePath << std::endl;
+        exit(1);
+    }
+    base = static_cast<char*>(addr);
+    madvise(base, length, MADV_SEQUENTIAL);
+
+    const Header* header = reinterpret_cast<const Header*>(base);
+    if (memcmp(header->magic, "KMTRACE", 8) != 0 ||
+            header->version != VERSION ||
+            header->recordSize != sizeof(Record)) {
+        std::cerr << "Unsupported trace format: " << filePath << std::endl;
+        exit(1);
+    }
+}
+
+/**
+ * ReplayTrace Destructor
+ */
+ReplayTrace::~ReplayTrace()
+{
+    munmap(base, length);
+    close(fd);
+}
+
+/**
+ * Return the next record in the trace.
+ *
+ * \return
+ *      Pointer to the next record, which remains valid until the following
+ *      call; NULL once the whole trace has been read.
+ */
+const ReplayTrace::Record*
+ReplayTrace::next()
+{
+    if (offset + sizeof(Record) > length) {
+        return NULL;
+    }
+
+    // Release the pages that have already been replayed.
+    if (offset - releasedOffset >= RELEASE_BYTES) {
+        size_t pageSize = sysconf(_SC_PAGESIZE);
+        size_t releaseEnd = offset & ~(pageSize - 1);
+        madvise(base + releasedOffset, releaseEnd - releasedOffset,
+                MADV_DONTNEED);
+        releasedOffset = releaseEnd;
+    }
+
+    const Record* record = reinterpret_cast<const Record*>(base + offset);
+    offset += sizeof(Record);
+    return record;
+}
+
+/**
+ * Return the total number of records in the trace.
+ */
+size_t
+ReplayTrace::getRecordCount()
+{
+    return (length - sizeof(Header)) / sizeof(Record);
+}
+
+}  // namespace Kafkamark
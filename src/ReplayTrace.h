@@ -0,0 +1,107 @@
+/* Copyright (c) 2017, Stanford University
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+ * OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef KAFKAMARK_REPLAYTRACE_H
+#define KAFKAMARK_REPLAYTRACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace Kafkamark {
+
+/**
+ * Provides sequential access to a binary traffic trace that should be
+ * replayed by the producer.  The trace file is memory-mapped and the pages
+ * already replayed are released as the trace is read, so traces much larger
+ * than memory can be replayed.
+ *
+ * A trace file consists of a Header followed by a sequence of Records in
+ * timestamp order; all fields are little-endian.
+ */
+class ReplayTrace {
+  public:
+    /**
+     * Identifies the trace file format.
+     */
+    struct Header {
+        /// Always "KMTRACE" followed by a NUL byte.
+        char magic[8];
+
+        /// Version of the trace file format.
+        uint32_t version;
+
+        /// Size of each Record in bytes.
+        uint32_t recordSize;
+    } __attribute__((packed));
+
+    /**
+     * A single message in the trace.
+     */
+    struct Record {
+        /// Time, in ns relative to the start of the trace, at which the
+        /// message was sent.
+        uint64_t timestampNS;
+
+        /// Message key; only used if the FLAG_KEY flag is set.
+        uint64_t key;
+
+        /// Size of the message payload in bytes.
+        uint32_t size;
+
+        /// Index of the topic, in [0, topic.count), the message was sent to.
+        uint32_t topic;
+
+        /// Partition the message was sent to; -1 to use the partitioner.
+        int32_t partition;
+
+        /// Bitwise or of the Record flags.
+        uint32_t flags;
+    } __attribute__((packed));
+
+    /// Record flag indicating that the message had a key.
+    static const uint32_t FLAG_KEY = 1 << 0;
+
+    /// Current version of the trace file format.
+    static const uint32_t VERSION = 1;
+
+    explicit ReplayTrace(const char* filePath);
+    ~ReplayTrace();
+
+    const Record* next();
+    size_t getRecordCount();
+
+  private:
+    /// File descriptor of the trace file.
+    int fd;
+
+    /// Start of the memory-mapped trace file.
+    char* base;
+
+    /// Length of the trace file in bytes.
+    size_t length;
+
+    /// Offset of the next record to be read.
+    size_t offset;
+
+    /// Offset up to which the replayed pages have been released.
+    size_t releasedOffset;
+
+    ReplayTrace(const ReplayTrace&);
+    ReplayTrace& operator=(const ReplayTrace&);
+};
+
+}  // namespace Kafkamark
+
+#endif  // KAFKAMARK_REPLAYTRACE_H
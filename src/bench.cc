@@ -0,0 +1,257 @@
+/* Copyright (c) 2017, Stanford University
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+ * OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "PerfUtils/Cycles.h"
+#include "PerfUtils/TimeTrace.h"
+
+#include "Histogram.h"
+#include "KafkaClient.h"
+#include "TraceLog.h"
+
+using namespace Kafkamark;
+using PerfUtils::Cycles;
+using PerfUtils::TimeTrace;
+
+/**
+ * Payload sizes, in bytes, at which produce() is measured.
+ */
+static const size_t PRODUCE_SIZES[] = {16, 128, 1024, 16384};
+
+/**
+ * Prevent the compiler from optimizing away the computation of a value or
+ * the object a pointer refers to.
+ */
+template<typename T>
+static inline void
+doNotOptimize(const T& value)
+{
+    asm volatile("" : : "r"(&value) : "memory");
+}
+
+/**
+ * Measure the cost of an operation and print its ns/op distribution.  The
+ * operation is timed in batches so that the cost of reading the TSC does not
+ * dominate cheap operations; each batch contributes one sample of its
+ * average ns/op.
+ *
+ * \param name
+ *      Name under which the result is printed.
+ * \param batches
+ *      Number of timed batches.
+ * \param batchSize
+ *      Number of times the operation is run in each batch.
+ * \param op
+ *      The operation to measure.
+ * \param warmUp
+ *      True, if the operation should first be run without recording; false
+ *      if it can only be run batches * batchSize times.
+ */
+template<typename Op>
+static void
+runBenchmark(const std::string& name, uint64_t batches, uint64_t batchSize,
+        Op op, bool warmUp = true)
+{
+    // Warm up caches and branch predictors without recording.
+    for (uint64_t i = 0; warmUp && i < batchSize * (batches / 10 + 1); ++i) {
+        op();
+    }
+
+    // Samples are recorded in ps/op; the histogram only holds integers.
+    Histogram histogram;
+    for (uint64_t batch = 0; batch < batches; ++batch) {
+        uint64_t startTSC = Cycles::rdtsc();
+        for (uint64_t i = 0; i < batchSize; ++i) {
+            op();
+        }
+        uint64_t stopTSC = Cycles::rdtsc();
+        histogram.record(Cycles::toNanoseconds((stopTSC - startTSC) * 1000) /
+                         batchSize);
+    }
+
+    double mean = static_cast<double>(histogram.sum) / histogram.count;
+    std::cout << std::left << std::setw(28) << name << std::right
+              << std::fixed << std::setprecision(1)
+              << std::setw(12) << histogram.count * batchSize
+              << std::setw(10) << mean / 1000
+              << std::setw(10) << histogram.percentile(0.5) / 1000.0
+              << std::setw(10) << histogram.percentile(0.9) / 1000.0
+              << std::setw(10) << histogram.percentile(0.99) / 1000.0
+              << std::setw(10) << histogram.max / 1000.0
+              << std::endl;
+}
+
+/**
+ * Measure the destruction of KafkaClient::Message wrappers around messages
+ * consumed from the topic, which hands each message back to librdkafka.
+ * Constructing an empty wrapper is free; releasing the message is the cost.
+ *
+ * \param variables
+ *      Options the consumer is configured with.
+ * \param batches
+ *      Number of timed batches; batches * batchSize messages are consumed
+ *      from the earliest offset up front.
+ * \param batchSize
+ *      Number of messages released in each batch.
+ */
+static void
+benchmarkMessage(ProgramOptions::variables_map& variables, uint64_t batches,
+        uint64_t batchSize)
+{
+    KafkaClient consumer(KafkaClient::CONSUMER);
+    consumer.consumeFromBeginning();
+    consumer.configure(variables);
+    if (!consumer.waitForAssignment(10*1000)) {
+        std::cerr << "Skipping ~KafkaClient::Message: no partitions "
+                  << "assigned." << std::endl;
+        return;
+    }
+
+    std::vector<KafkaClient::Message*> messages;
+    while (messages.size() < batches * batchSize) {
+        KafkaClient::Message* msg = new KafkaClient::Message();
+        if (!consumer.consume(msg, 1000)) {
+            delete msg;
+            break;
+        }
+        messages.push_back(msg);
+    }
+    if (messages.size() < batchSize) {
+        std::cerr << "Skipping ~KafkaClient::Message: too few messages "
+                  << "consumed." << std::endl;
+        return;
+    }
+
+    size_t next = 0;
+    runBenchmark("~KafkaClient::Message", messages.size() / batchSize,
+            batchSize, [&] {
+        delete messages[next++];
+    }, false);
+    while (next < messages.size()) {
+        delete messages[next++];
+    }
+}
+
+/**
+ * Microbenchmarks for kafkamark's own instrumentation and client hot paths,
+ * which tell how much of every reported latency is the tool itself.
+ */
+int
+main(int argc, char const *argv[])
+{
+    KafkaClient client(KafkaClient::PRODUCER);
+
+    std::string traceFile;
+    uint64_t batches;
+    uint64_t batchSize;
+    uint64_t produceBatches;
+
+    // Get Command Line Options
+    OptionsDescription options("Usage");
+    options.add_options()
+        ("help",
+            "produce help message")
+        ("batches",
+            ProgramOptions::value< uint64_t >(&batches)
+                    ->default_value(10000),
+            "Number of timed batches per benchmark.")
+        ("batch.size",
+            ProgramOptions::value< uint64_t >(&batchSize)
+                    ->default_value(100),
+            "Number of operations per timed batch.")
+        ("produce.batches",
+            ProgramOptions::value< uint64_t >(&produceBatches)
+                    ->default_value(100),
+            "Number of timed batches per produce benchmark; keep the total "
+            "below queue.buffering.max.messages when no broker is reachable.")
+        ("trace.file",
+            ProgramOptions::value< std::string >(&traceFile)
+                    ->default_value("/dev/null"),
+            "File the TraceLog benchmark records to.")
+    ;
+    client.addOptionsTo(options);
+
+    ProgramOptions::variables_map variables;
+    ProgramOptions::store(ProgramOptions::parse_command_line(argc,
+                                                             argv,
+                                                             options),
+                          variables);
+    ProgramOptions::notify(variables);
+
+    if (variables.count("help")) {
+        std::cout << "Produce benchmarks run only if --brokers and --topic "
+                  << "are given; the brokers need not be reachable since "
+                  << "messages only have to be enqueued.  The message "
+                  << "benchmark also needs --brokers and --topic, and a "
+                  << "reachable broker to consume from." << std::endl;
+        std::cout << options << std::endl;
+        return 0;
+    }
+
+    if (batches == 0 || batchSize == 0) {
+        std::cerr << "--batches and --batch.size must be positive."
+                  << std::endl;
+        exit(1);
+    }
+
+    TraceLog::setOutputFilePath(traceFile.c_str());
+
+    std::cout << std::left << std::setw(28) << "benchmark" << std::right
+              << std::setw(12) << "ops"
+              << std::setw(10) << "mean"
+              << std::setw(10) << "p50"
+              << std::setw(10) << "p90"
+              << std::setw(10) << "p99"
+              << std::setw(10) << "max"
+              << "  (ns/op)" << std::endl;
+
+    runBenchmark("Cycles::rdtsc", batches, batchSize, [] {
+        uint64_t tsc = Cycles::rdtsc();
+        doNotOptimize(tsc);
+    });
+
+    uint64_t id = 0;
+    runBenchmark("TimeTrace::record", batches, batchSize, [&id] {
+        TimeTrace::record("Producer: Sending Message %4d", id++);
+    });
+
+    runBenchmark("TraceLog::record", batches, batchSize, [&id] {
+        TraceLog::record("PRODUCE|%lu|%lu", id++, 0UL);
+    });
+    TraceLog::flush();
+
+    if (variables.count("brokers") && variables.count("topic")) {
+        client.configure(variables);
+
+        std::vector<char> payload(PRODUCE_SIZES[
+                sizeof(PRODUCE_SIZES) / sizeof(PRODUCE_SIZES[0]) - 1], 'x');
+        for (size_t size : PRODUCE_SIZES) {
+            std::string name = "KafkaClient::produce/" + std::to_string(size);
+            runBenchmark(name, produceBatches, batchSize, [&] {
+                client.produce(payload.data(), size);
+            });
+        }
+
+        // The produced messages are consumed back for the next benchmark.
+        client.flush(10*1000);
+        benchmarkMessage(variables, produceBatches, batchSize);
+    }
+
+    return 0;
+}
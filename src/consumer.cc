@@ -15,9 +15,14 @@
 
 #include <signal.h>
 
+#include <atomic>
+
 #include "PerfUtils/Cycles.h"
 #include "PerfUtils/TimeTrace.h"
 
+#include "Agent.h"
+#include "AllocStats.h"
+#include "Histogram.h"
 #include "KafkaClient.h"
 #include "Payload.h"
 #include "TraceLog.h"
@@ -27,9 +32,10 @@ using PerfUtils::Cycles;
 using PerfUtils::TimeTrace;
 
 /**
- * Signal whether or not the application should continue to run.
+ * Signal whether or not the application should continue to run.  Cleared
+ * from the SIGINT handler and from the Agent's stop watcher thread.
  */
-static bool run = true;
+static std::atomic<bool> run(true);
 
 /**
  * Custom signal handler for SIGINT to gracefully exit.
@@ -38,12 +44,69 @@ void handle_sigint(int s) {
     run = false;
 }
 
+/**
+ * Time at which the Agent stopped the run; 0 until then.
+ */
+static std::atomic<uint64_t> stopTSC(0);
+
+/**
+ * Called by the Agent once the driver's run is over.
+ */
+void handle_stop() {
+    stopTSC = Cycles::rdtsc();
+    run = false;
+}
+
+/**
+ * Log the receipt of a message and, in request/reply mode, echo it back.
+ *
+ * \param client
+ *      Client the message was consumed from.
+ * \param msg
+ *      The received message.
+ * \param endTSC
+ *      Time at which the message was received.
+ * \param respond
+ *      True, if the message should be echoed to the reply topic.
+ * \param latencyHistogram
+ *      Histogram in which the message's end-to-end latency is recorded.
+ * \return
+ *      True, if the message was handled without error.  False, otherwise.
+ */
+bool
+receiveMessage(KafkaClient* client, KafkaClient::Message* msg,
+        uint64_t endTSC, bool respond, Histogram* latencyHistogram)
+{
+    Payload::Header* header = (Payload::Header*) msg->payload;
+
+    // Echo the request, header intact, back to the requester
+    if (respond && !client->produce((char*) msg->payload, msg->len)) {
+        return false;
+    }
+
+    TimeTrace::record(endTSC,
+            "Consumer: Message %4d Received in %9lu us",
+            header->msgId,
+            Cycles::toMicroseconds(endTSC - header->timestampTSC));
+    TraceLog::record(endTSC,
+            "CONSUME|Message %4d Received in %9lu us",
+            header->msgId,
+            Cycles::toMicroseconds(endTSC - header->timestampTSC));
+    latencyHistogram->record(
+            Cycles::toNanoseconds(endTSC - header->timestampTSC));
+    return true;
+}
+
 int
 main(int argc, char const *argv[])
 {
-    KafkaClient client(KafkaClient::CONSUMER);
+    KafkaClient client(KafkaClient::CONSUMER | KafkaClient::REPLY);
 
     std::string logDir;
+    uint64_t reportIntervalMS;
+    uint64_t allocStatsMS;
+    int eventTimerMS;
+    uint16_t agentPort;
 
     // Get Command Line Options
     OptionsDescription options("Usage");
@@ -53,6 +116,31 @@ main(int argc, char const *argv[])
         ("logDir,L",
             ProgramOptions::value< std::string >(&logDir),
             "Destination log directory for log output.")
+        ("catchup",
+            "Drain the topic's backlog from the earliest offset, in a "
+            "consumer group of its own, as fast as possible and exit once "
+            "the consumer has caught up.")
+        ("report.interval.ms",
+            ProgramOptions::value< uint64_t >(&reportIntervalMS)
+                    ->default_value(1000),
+            "Interval, in milliseconds, between progress reports in catchup "
+            "mode.")
+        ("event.driven",
+            "Serve every assigned partition's queue from one thread using "
+            "queue event fds and epoll instead of blocking consume calls.")
+        ("event.timer.ms",
+            ProgramOptions::value< int >(&eventTimerMS)->default_value(100),
+            "Interval, in milliseconds, of the housekeeping timer served "
+            "along with the queues in event-driven mode.")
+        ("alloc.stats.ms",
+            ProgramOptions::value< uint64_t >(&allocStatsMS)
+                    ->default_value(0),
+            "Interval, in milliseconds, at which heap allocation counters "
+            "and RSS are recorded (0 disables allocation accounting).")
+        ("agent.port",
+            ProgramOptions::value< uint16_t >(&agentPort)->default_value(0),
+            "Run as an agent controlled by 'kafkamark agents' on this TCP "
+            "port (0 means the consumer runs standalone).")
     ;
     client.addOptionsTo(options);
 
@@ -85,6 +173,30 @@ main(int argc, char const *argv[])
         TraceLog::setOutputFilePath(traceLogPath.c_str());
     }
 
+    bool catchup = variables.count("catchup");
+    bool respond = variables.count("reply.topic");
+    bool eventDriven = variables.count("event.driven");
+
+    if (eventDriven) {
+        if (catchup || eventTimerMS <= 0) {
+            std::cerr << "event.driven requires a positive event.timer.ms "
+                      << "and cannot be combined with catchup."
+                      << std::endl;
+            return 1;
+        }
+        client.enableEvents(eventTimerMS);
+    }
+
+    // Drain the whole backlog, not just what arrives after joining.
+    if (catchup) {
+        client.consumeFromBeginning();
+    }
+
+    Agent* agent = NULL;
+    if (agentPort > 0) {
+        agent = new Agent(agentPort, handle_stop);
+    }
+
     client.configure(variables);
 
     // Set SIGING handler
@@ -98,11 +210,95 @@ main(int argc, char const *argv[])
     // uint64_t firstNAtsc = 0;
     // int noMsgCnt = 0;
 
+    // Wait for the driver to start all agents together
+    if (agent) {
+        agent->waitForStart();
+    }
+    uint64_t startTSC = Cycles::rdtsc();
+
+    uint64_t msgCount = 0;
+    Histogram latencyHistogram;
+    if (allocStatsMS > 0) {
+        AllocStats::enable(allocStatsMS);
+    }
+
+    // Catch-up Workload
+    if (catchup) {
+        uint64_t reportIntervalTSC = Cycles::fromSeconds(
+                static_cast<double>(reportIntervalMS) / 1000);
+        uint64_t nextReportTSC = startTSC + reportIntervalTSC;
+        uint64_t byteCount = 0;
+        uint64_t lastMsgTSC = startTSC;
+
+        TraceLog::record(startTSC, "CATCHUP|0|0|-1");
+        while (run) {
+            KafkaClient::Message msg;
+            if (client.consume(&msg, 100)) {
+                lastMsgTSC = Cycles::rdtsc();
+                ++msgCount;
+                byteCount += msg.len;
+                AllocStats::sample(msgCount);
+            }
+
+            uint64_t now = Cycles::rdtsc();
+            if (now < nextReportTSC) {
+                continue;
+            }
+            nextReportTSC = now + reportIntervalTSC;
+
+            int64_t lag = client.getLag(1000);
+            now = Cycles::rdtsc();
+            TraceLog::record(now, "CATCHUP|%lu|%lu|%ld",
+                    msgCount, byteCount, lag);
+            if (lag == 0) {
+                // The backlog was drained by the last message, not by the
+                // time the lag was checked.
+                TraceLog::record(lastMsgTSC, "CAUGHTUP|%lu|%lu|%lu",
+                        msgCount, byteCount,
+                        Cycles::toMicroseconds(lastMsgTSC - startTSC));
+                break;
+            }
+        }
+        run = false;
+    }
+
+    // Event-driven Workload
+    if (eventDriven) {
+        uint64_t wakeups = 0;
+        uint64_t timerTicks = 0;
+        while (run) {
+            // Timer ticks only check whether the run is over; they are not
+            // counted as wakeups.
+            if (client.waitForEvents(-1, &timerTicks) == 0) {
+                continue;
+            }
+            ++wakeups;
+
+            while (run) {
+                KafkaClient::Message msg;
+                if (!client.consumeReady(&msg)) {
+                    break;
+                }
+                ++msgCount;
+                if (!receiveMessage(&client, &msg, Cycles::rdtsc(), respond,
+                        &latencyHistogram)) {
+                    run = false;
+                }
+                AllocStats::sample(msgCount);
+            }
+        }
+        TraceLog::record("EVENTS|%lu|%lu|%lu", wakeups, msgCount,
+                timerTicks);
+    }
+
+    // An agent must notice the end of the run promptly to report on time.
+    int consumeTimeoutMS = agent ? 100 : 10000;
+
     // Run Workload
     while (run) {
         KafkaClient::Message msg;
         // uint64_t startTime = Cycles::rdtsc();
-        if (!client.consume(&msg, 10000)) {
+        if (!client.consume(&msg, consumeTimeoutMS)) {
             uint64_t endTSC = Cycles::rdtsc();
             // TimeTrace::record(startTime, "Consumer: Get Message");
             TimeTrace::record(endTSC, "Consumer: No Message Received");
@@ -113,17 +309,14 @@ main(int argc, char const *argv[])
             // ++noMsgCnt;
         } else {
             uint64_t endTSC = Cycles::rdtsc();
-            Payload::Header* header = (Payload::Header*) msg.payload;
 
             // TimeTrace::record(startTime, "Consumer: Get Message");
-            TimeTrace::record(endTSC,
-                    "Consumer: Message %4d Received in %9lu us",
-                    header->msgId,
-                    Cycles::toMicroseconds(endTSC - header->timestampTSC));
-            TraceLog::record(endTSC,
-                    "CONSUME|Message %4d Received in %9lu us",
-                    header->msgId,
-                    Cycles::toMicroseconds(endTSC - header->timestampTSC));
+            if (!receiveMessage(&client, &msg, endTSC, respond,
+                    &latencyHistogram)) {
+                break;
+            }
+            ++msgCount;
+            AllocStats::sample(msgCount);
 
             // if (noMsgCnt > 0) {
             //     TimeTrace::record(firstNAtsc,
@@ -141,6 +334,26 @@ main(int argc, char const *argv[])
         }
     }
 
+    AllocStats::record(msgCount);
+
+    // Report this agent's results to the driver
+    if (agent) {
+        // The run ended when the agent stopped it, not when the workload
+        // loop noticed.
+        uint64_t endTSC = stopTSC;
+        if (endTSC == 0) {
+            endTSC = Cycles::rdtsc();
+        }
+        agent->sendCounter("consumed.msgs", msgCount);
+        agent->sendCounter("consumed.us",
+                Cycles::toMicroseconds(endTSC - startTSC));
+        if (latencyHistogram.count > 0) {
+            agent->sendHistogram("latency.ns", latencyHistogram);
+        }
+        agent->finish();
+        delete agent;
+    }
+
     TimeTrace::print();
     TraceLog::flush();
 
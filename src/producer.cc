@@ -14,12 +14,25 @@
  */
 
 #include <signal.h>
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <map>
+#include <random>
+#include <vector>
 
 #include "PerfUtils/Cycles.h"
 #include "PerfUtils/TimeTrace.h"
 
+#include "Agent.h"
+#include "AllocStats.h"
+#include "Histogram.h"
 #include "KafkaClient.h"
+#include "Pacer.h"
 #include "Payload.h"
+#include "ReplayTrace.h"
 #include "TraceLog.h"
 
 using namespace Kafkamark;
@@ -27,9 +40,10 @@ using PerfUtils::Cycles;
 using PerfUtils::TimeTrace;
 
 /**
- * Signal whether or not the application should continue to run.
+ * Signal whether or not the application should continue to run.  Cleared
+ * from the SIGINT handler and from the Agent's stop watcher thread.
  */
-static bool run = true;
+static std::atomic<bool> run(true);
 
 /**
  * Custom signal handler for SIGINT to gracefully exit.
@@ -38,12 +52,95 @@ void handle_sigint(int s) {
     run = false;
 }
 
+/**
+ * Time at which the Agent stopped the run; 0 until then.
+ */
+static std::atomic<uint64_t> stopTSC(0);
+
+/**
+ * Called by the Agent once the driver's run is over.
+ */
+void handle_stop() {
+    stopTSC = Cycles::rdtsc();
+    run = false;
+}
+
+/**
+ * Return the user plus system CPU time, in us, recorded in the provided
+ * resource usage.
+ */
+uint64_t
+cpuMicroseconds(const struct rusage& usage)
+{
+    return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000UL +
+           usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+/**
+ * Log the CPU time consumed by the calling (sending) thread and by the whole
+ * process, including the client library's threads.
+ *
+ * \param startTSC
+ *      Time at which the workload started.
+ */
+void
+recordCPUUsage(uint64_t startTSC)
+{
+    struct rusage threadUsage;
+    struct rusage processUsage;
+    getrusage(RUSAGE_THREAD, &threadUsage);
+    getrusage(RUSAGE_SELF, &processUsage);
+    uint64_t endTSC = Cycles::rdtsc();
+    TraceLog::record(endTSC, "CPU|%lu|%lu|%lu",
+            cpuMicroseconds(threadUsage),
+            cpuMicroseconds(processUsage),
+            Cycles::toMicroseconds(endTSC - startTSC));
+}
+
+/**
+ * Commit the client's current transaction and log how long the commit took.
+ *
+ * \param client
+ *      Client whose current transaction should be committed.
+ * \param msgCount
+ *      Number of messages produced as part of the transaction.
+ * \return
+ *      True, if the transaction committed without error.  False, otherwise.
+ */
+bool
+commitTransaction(KafkaClient* client, uint64_t msgCount)
+{
+    uint64_t startTSC = Cycles::rdtsc();
+    TimeTrace::record(startTSC, "commit...");
+    if (!client->commitTransaction(30*1000)) {
+        return false;
+    }
+    uint64_t endTSC = Cycles::rdtsc();
+    TimeTrace::record(endTSC, "...committed");
+    TraceLog::record(endTSC, "COMMIT|%lu|%lu",
+            msgCount, Cycles::toMicroseconds(endTSC - startTSC));
+    return true;
+}
+
 int
 main(int argc, char const *argv[])
 {
-    KafkaClient client(KafkaClient::PRODUCER);
+    KafkaClient client(KafkaClient::PRODUCER | KafkaClient::REPLY);
 
     double targetOPS;
+    size_t msgSize;
+    uint64_t preloadMessages;
+    uint64_t preloadBytes;
+    uint64_t transactionSize;
+    uint64_t window;
+    uint64_t replyTimeoutMS;
+    std::string topicDistribution;
+    double zipfExponent;
+    std::string replayTracePath;
+    double replaySpeed;
+    uint64_t pacerSpinUS;
+    uint64_t allocStatsMS;
+    uint16_t agentPort;
     std::string logDir;
 
     // Get Command Line Options
@@ -58,6 +155,66 @@ main(int argc, char const *argv[])
             ProgramOptions::value< double >(&targetOPS)->default_value(0),
             "Operations per second the producer should attempt to offer "
             "(0 means there should be no throughput control).")
+        ("msg.size",
+            ProgramOptions::value< size_t >(&msgSize)->default_value(100),
+            "Size in bytes of each produced message (including the "
+            "kafkamark header).")
+        ("preload.messages",
+            ProgramOptions::value< uint64_t >(&preloadMessages)
+                    ->default_value(0),
+            "Bulk load the topic with this many messages as fast as "
+            "possible and then exit (0 means no message limit).")
+        ("preload.bytes",
+            ProgramOptions::value< uint64_t >(&preloadBytes)
+                    ->default_value(0),
+            "Bulk load the topic with this many bytes as fast as possible "
+            "and then exit (0 means no byte limit).")
+        ("transaction.size",
+            ProgramOptions::value< uint64_t >(&transactionSize)
+                    ->default_value(0),
+            "Number of messages produced in each transaction (0 means "
+            "messages are not produced in transactions). Must be given "
+            "together with --transactional.id.")
+        ("window",
+            ProgramOptions::value< uint64_t >(&window)->default_value(1),
+            "Number of outstanding requests in request/reply mode (enabled "
+            "with --reply.topic).")
+        ("reply.timeout.ms",
+            ProgramOptions::value< uint64_t >(&replyTimeoutMS)
+                    ->default_value(10000),
+            "Time, in milliseconds, after which a request without a reply "
+            "is given up on and leaves the window in request/reply mode.")
+        ("topic.distribution",
+            ProgramOptions::value< std::string >(&topicDistribution)
+                    ->default_value("uniform"),
+            "How messages are spread over the topics when topic.count is "
+            "greater than 1: uniform or zipf.")
+        ("zipf.exponent",
+            ProgramOptions::value< double >(&zipfExponent)->default_value(1.0),
+            "Exponent of the zipf topic distribution.")
+        ("replay.trace",
+            ProgramOptions::value< std::string >(&replayTracePath),
+            "Replay the traffic recorded in this binary trace file instead "
+            "of generating fixed-rate traffic.")
+        ("replay.speed",
+            ProgramOptions::value< double >(&replaySpeed)->default_value(1.0),
+            "Speed at which the trace is replayed relative to the recorded "
+            "timestamps (e.g. 2 replays twice as fast).")
+        ("pacer.spin.us",
+            ProgramOptions::value< uint64_t >(&pacerSpinUS)
+                    ->default_value(100),
+            "Gaps between sends of at most this many microseconds are spun "
+            "rather than slept; longer gaps sleep until this long before the "
+            "scheduled send time.")
+        ("alloc.stats.ms",
+            ProgramOptions::value< uint64_t >(&allocStatsMS)
+                    ->default_value(0),
+            "Interval, in milliseconds, at which heap allocation counters "
+            "and RSS are recorded (0 disables allocation accounting).")
+        ("agent.port",
+            ProgramOptions::value< uint16_t >(&agentPort)->default_value(0),
+            "Run as an agent controlled by 'kafkamark agents' on this TCP "
+            "port (0 means the producer runs standalone).")
     ;
     client.addOptionsTo(options);
 
@@ -90,6 +247,58 @@ main(int argc, char const *argv[])
         TraceLog::setOutputFilePath(traceLogPath.c_str());
     }
 
+    if (msgSize < sizeof(Payload::Header)) {
+        std::cerr << "msg.size must be at least "
+                  << sizeof(Payload::Header)
+                  << " bytes."
+                  << std::endl;
+        return 1;
+    }
+
+    // A transactional producer can only produce inside a transaction.
+    if ((transactionSize > 0) != (variables.count("transactional.id") > 0)) {
+        std::cerr << "transaction.size and transactional.id must be given "
+                  << "together."
+                  << std::endl;
+        return 1;
+    }
+
+    if (topicDistribution != "uniform" && topicDistribution != "zipf") {
+        std::cerr << "topic.distribution must be uniform or zipf."
+                  << std::endl;
+        return 1;
+    }
+
+    bool replay = variables.count("replay.trace");
+    if (replay && replaySpeed <= 0) {
+        std::cerr << "replay.speed must be positive." << std::endl;
+        return 1;
+    }
+
+    bool requestReply = variables.count("reply.topic");
+    if (requestReply && window == 0) {
+        std::cerr << "window must be at least 1." << std::endl;
+        return 1;
+    }
+
+    // Transactions are only produced by the generated traffic workload.
+    if (transactionSize > 0 && (replay || requestReply)) {
+        std::cerr << "transaction.size cannot be combined with replay.trace "
+                  << "or reply.topic."
+                  << std::endl;
+        return 1;
+    }
+
+    bool preload = (preloadMessages > 0 || preloadBytes > 0);
+    if (preload) {
+        targetOPS = 0;
+    }
+
+    Agent* agent = NULL;
+    if (agentPort > 0) {
+        agent = new Agent(agentPort, handle_stop);
+    }
+
     client.configure(variables);
 
     // Set SIGING handler
@@ -97,33 +306,296 @@ main(int argc, char const *argv[])
 
     TraceLog::record("CPS|%f", Cycles::perSecond());
 
+    // Open all topics up front so that the cost of the topic handles and
+    // their metadata is measured separately from the workload.
+    size_t topicCount = client.getTopicCount();
+    std::vector<double> topicCDF;
+    if (topicCount > 1) {
+        uint64_t rssBefore = AllocStats::getRSS();
+        uint64_t openStartTSC = Cycles::rdtsc();
+        client.openTopics();
+        uint64_t openEndTSC = Cycles::rdtsc();
+
+        uint64_t metadataStartTSC = Cycles::rdtsc();
+        if (client.refreshMetadata(30*1000)) {
+            uint64_t metadataEndTSC = Cycles::rdtsc();
+            TraceLog::record(metadataEndTSC, "METADATA|%lu|%lu",
+                    topicCount,
+                    Cycles::toMicroseconds(metadataEndTSC -
+                                           metadataStartTSC));
+        }
+
+        // Sampled after the refresh, once the client library has built its
+        // per-partition state for every topic.
+        uint64_t rssAfter = AllocStats::getRSS();
+        TraceLog::record(openEndTSC, "TOPICS|%lu|%lu|%lu",
+                topicCount,
+                Cycles::toMicroseconds(openEndTSC - openStartTSC),
+                rssAfter > rssBefore ? rssAfter - rssBefore : 0);
+
+        // Cumulative distribution used to pick each message's topic
+        topicCDF.resize(topicCount);
+        double total = 0;
+        for (size_t i = 0; i < topicCount; ++i) {
+            if (topicDistribution == "zipf") {
+                total += 1.0 / std::pow(static_cast<double>(i + 1),
+                                        zipfExponent);
+            } else {
+                total += 1.0;
+            }
+            topicCDF[i] = total;
+        }
+        for (size_t i = 0; i < topicCount; ++i) {
+            topicCDF[i] /= total;
+        }
+    }
+    // Wait for the driver to start all agents together
+    if (agent) {
+        agent->waitForStart();
+    }
+
+    if (allocStatsMS > 0) {
+        AllocStats::enable(allocStatsMS);
+    }
+
+    Pacer pacer(pacerSpinUS * 1000);
+    std::mt19937_64 generator(Cycles::rdtsc());
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+
     // Compute delay
     uint64_t sendDelayTSC = 0;
     if (targetOPS > 0) {
         sendDelayTSC = PerfUtils::Cycles::fromSeconds(1.0 / targetOPS);
     }
     uint64_t nextSendTSC = PerfUtils::Cycles::rdtsc();
-    char buf[100];
-    Payload::Header* header = (Payload::Header*) buf;
+    std::vector<char> buf(msgSize);
+    Payload::Header* header = (Payload::Header*) buf.data();
     uint64_t msgId = 0;
+    uint64_t bytesSent = 0;
+    uint64_t transactionCount = 0;
+    uint64_t startTSC = PerfUtils::Cycles::rdtsc();
+    Histogram sendErrorHistogram;
+    Histogram rttHistogram;
+
+    // Request/Reply Workload
+    if (requestReply) {
+        // Requests sent before the reply consumer joins would get no reply.
+        if (!client.waitForAssignment(30*1000)) {
+            std::cerr << "Reply consumer was not assigned any partitions."
+                      << std::endl;
+            run = false;
+        }
+
+        uint64_t replyTimeoutTSC = Cycles::fromNanoseconds(
+                replyTimeoutMS * 1000000);
+
+        // Send time of each outstanding request, by msgId
+        std::map<uint64_t, uint64_t> outstanding;
+        while (run) {
+            // Give up on requests whose reply is overdue; a late reply then
+            // no longer matches, so the window is never exceeded.
+            uint64_t now = Cycles::rdtsc();
+            while (!outstanding.empty() &&
+                    now - outstanding.begin()->second > replyTimeoutTSC) {
+                TraceLog::record(now, "REPLY_TIMEOUT|%lu",
+                        outstanding.begin()->first);
+                outstanding.erase(outstanding.begin());
+            }
+
+            // Fill the window of outstanding requests
+            while (outstanding.size() < window) {
+                header->msgId = ++msgId;
+                header->timestampTSC = PerfUtils::Cycles::rdtsc();
+                if (!client.produce(buf.data(), msgSize)) {
+                    run = false;
+                    break;
+                }
+                bytesSent += msgSize;
+                outstanding[header->msgId] = header->timestampTSC;
+            }
+
+            KafkaClient::Message reply;
+            if (!client.consume(&reply, 100)) {
+                continue;
+            }
+
+            uint64_t endTSC = Cycles::rdtsc();
+            if (reply.len < sizeof(Payload::Header)) {
+                continue;
+            }
+
+            // Skip replies to other requesters and to expired requests.
+            Payload::Header* replyHeader = (Payload::Header*) reply.payload;
+            std::map<uint64_t, uint64_t>::iterator request =
+                    outstanding.find(replyHeader->msgId);
+            if (request == outstanding.end() ||
+                    request->second != replyHeader->timestampTSC) {
+                continue;
+            }
+            outstanding.erase(request);
+
+            TimeTrace::record(endTSC, "Producer: Reply %4d Received",
+                    replyHeader->msgId);
+            TraceLog::record(endTSC, "REPLY|%lu|%lu",
+                    replyHeader->msgId,
+                    Cycles::toMicroseconds(endTSC -
+                                           replyHeader->timestampTSC));
+            rttHistogram.record(Cycles::toNanoseconds(endTSC -
+                                replyHeader->timestampTSC));
+            AllocStats::sample(msgId);
+        }
+    }
+
+    // Trace Replay Workload
+    if (replay) {
+        ReplayTrace trace(replayTracePath.c_str());
+        uint64_t replayStartTSC = Cycles::rdtsc();
+        TraceLog::record(replayStartTSC, "REPLAY_TRACE|%lu",
+                trace.getRecordCount());
+        const ReplayTrace::Record* record;
+        while (run && (record = trace.next()) != NULL) {
+            uint64_t scheduledTSC = replayStartTSC + Cycles::fromNanoseconds(
+                    static_cast<uint64_t>(record->timestampNS / replaySpeed));
+
+            size_t size = std::max(static_cast<size_t>(record->size),
+                                   sizeof(Payload::Header));
+            if (buf.size() < size) {
+                buf.resize(size);
+                header = (Payload::Header*) buf.data();
+            }
+
+            // Topics beyond topic.count wrap around.
+            size_t topicIndex = record->topic % topicCount;
+            const void* key = NULL;
+            size_t keyLen = 0;
+            if (record->flags & ReplayTrace::FLAG_KEY) {
+                key = &record->key;
+                keyLen = sizeof(record->key);
+            }
+
+            // Throttle
+            pacer.waitUntil(scheduledTSC);
+
+            header->msgId = ++msgId;
+            header->timestampTSC = Cycles::rdtsc();
+            if (!client.produce(buf.data(), size, topicIndex,
+                    record->partition, key, keyLen)) {
+                break;
+            }
+
+            // Log how far the send drifted from its scheduled time
+            uint64_t driftNS = Cycles::toNanoseconds(header->timestampTSC -
+                                                     scheduledTSC);
+            TraceLog::record(header->timestampTSC, "REPLAY|%lu|%lu",
+                    header->msgId, driftNS);
+            sendErrorHistogram.record(driftNS);
+            bytesSent += size;
+            AllocStats::sample(msgId);
+        }
+        run = false;
+    }
 
     while (run) {
+        if (preloadMessages > 0 && msgId >= preloadMessages) {
+            break;
+        }
+        if (preloadBytes > 0 && bytesSent >= preloadBytes) {
+            break;
+        }
+
+        if (transactionSize > 0 && transactionCount == 0) {
+            if (!client.beginTransaction()) {
+                break;
+            }
+        }
+
         header->msgId = ++msgId;
         header->timestampTSC = PerfUtils::Cycles::rdtsc();
 
+        size_t topicIndex = 0;
+        if (topicCount > 1) {
+            topicIndex = std::upper_bound(topicCDF.begin(),
+                                          topicCDF.end() - 1,
+                                          uniform(generator)) -
+                         topicCDF.begin();
+        }
+
         TimeTrace::record("produce...");
-        if (!client.produce(buf, 100)) {
+        if (!client.produce(buf.data(), msgSize, topicIndex)) {
             break;
         }
         TimeTrace::record("...done");
+        bytesSent += msgSize;
+        AllocStats::sample(msgId);
+        ++transactionCount;
+
+        // Log Send, along with how late it was relative to its scheduled
+        // time if there is a target rate; skipped during a preload so that
+        // logging does not limit the load rate.
+        if (sendDelayTSC > 0) {
+            uint64_t paceErrorNS = Cycles::toNanoseconds(
+                    header->timestampTSC - nextSendTSC);
+            sendErrorHistogram.record(paceErrorNS);
+            TraceLog::record(header->timestampTSC, "PRODUCE|%d|%lu",
+                    header->msgId, paceErrorNS);
+        } else if (!preload) {
+            TraceLog::record(header->timestampTSC, "PRODUCE|%d",
+                    header->msgId);
+        }
 
-        // Log Send
-        TraceLog::record(header->timestampTSC, "PRODUCE|%d",
-                header->msgId);
+        if (transactionSize > 0 && transactionCount == transactionSize) {
+            bool committed = commitTransaction(&client, transactionCount);
+            // A failed transaction has been aborted; nothing is left to
+            // commit after the loop.
+            transactionCount = 0;
+            if (!committed) {
+                break;
+            }
+        }
 
         nextSendTSC += sendDelayTSC;
         // Throttle
-        while (nextSendTSC > PerfUtils::Cycles::rdtsc());
+        pacer.waitUntil(nextSendTSC);
+    }
+
+    // The workload is over; what follows is cleanup and reporting.
+    uint64_t workloadEndTSC = Cycles::rdtsc();
+
+    if (transactionSize > 0 && transactionCount > 0) {
+        commitTransaction(&client, transactionCount);
+    }
+
+    if (preload) {
+        while (run && !client.flush(1000));
+        uint64_t endTSC = PerfUtils::Cycles::rdtsc();
+        TraceLog::record(endTSC, "PRELOAD|%lu|%lu|%lu",
+                msgId, bytesSent,
+                Cycles::toMicroseconds(endTSC - startTSC));
+    }
+
+    recordCPUUsage(startTSC);
+    AllocStats::record(msgId);
+
+    // Report this agent's results to the driver
+    if (agent) {
+        // The run ended when the agent stopped it, not when the workload
+        // loop noticed.
+        uint64_t endTSC = stopTSC;
+        if (endTSC == 0 || endTSC > workloadEndTSC) {
+            endTSC = workloadEndTSC;
+        }
+        agent->sendCounter("produced.msgs", msgId);
+        agent->sendCounter("produced.bytes", bytesSent);
+        agent->sendCounter("produced.us",
+                Cycles::toMicroseconds(endTSC - startTSC));
+        if (sendErrorHistogram.count > 0) {
+            agent->sendHistogram("send.error.ns", sendErrorHistogram);
+        }
+        if (rttHistogram.count > 0) {
+            agent->sendHistogram("rtt.ns", rttHistogram);
+        }
+        agent->finish();
+        delete agent;
     }
 
     TimeTrace::print();